@@ -0,0 +1,62 @@
+#pragma once
+
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+#include "wait_result.hpp"
+
+/**
+ * @brief Locations of the AGVs, set by the AGV status callbacks and awaited by the order thread
+ *
+ * Locations are the values of ariac_msgs::msg::AGVStatus (KITTING, ASSEMBLY_FRONT,
+ * ASSEMBLY_BACK, WAREHOUSE), or -1 while the AGV has not reported yet. Threads waiting
+ * for an AGV to reach a location block until it does, the deadline expires or the
+ * waits are cancelled, when the competition ends.
+ */
+class AgvLocations
+{
+public:
+    /**
+     * @brief Construct a new AgvLocations object
+     *
+     * @param count  Number of AGVs, numbered from 1
+     */
+    explicit AgvLocations(int count);
+
+    /**
+     * @brief Set the location of an AGV and wake up the waiting threads
+     *
+     * @param agv_num  Number of the AGV, ignored if out of range
+     * @param location  Location of the AGV
+     * @return int Previous location of the AGV
+     */
+    int set(int agv_num, int location);
+
+    /**
+     * @brief Get the location of an AGV, -1 if unknown
+     */
+    int get(int agv_num) const;
+
+    /**
+     * @brief Block until an AGV is at a location
+     *
+     * @param agv_num  Number of the AGV
+     * @param location  Awaited location
+     * @param timeout  Timeout in seconds
+     * @return WaitResult READY if the AGV is at the location, CANCELLED, or TIMEOUT (also for an unknown AGV)
+     */
+    WaitResult wait_for(int agv_num, int location, double timeout) const;
+
+    /**
+     * @brief Wake up the waiting threads and make every later wait fail
+     */
+    void cancel();
+
+private:
+    //! Location of each AGV, indexed by AGV number - 1
+    std::vector<int> locations_;
+    bool cancelled_{false};
+    mutable std::mutex mutex_;
+    mutable std::condition_variable changed_;
+};
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+
+/**
+ * @brief Counters of the heap allocations made through the global operator new
+ *
+ * src/allocation_counter.cpp replaces the global operator new of the executable it is
+ * linked in. Counting is per thread, so that a motion measured in a service thread is
+ * not polluted by the executor threads.
+ */
+namespace allocation_counter
+{
+    /**
+     * @brief Number of allocations made by the calling thread so far
+     */
+    uint64_t thread_allocations();
+
+    /**
+     * @brief Number of allocations made by all threads so far
+     */
+    uint64_t total_allocations();
+
+    //! Allocations made by the calling thread during the lifetime of the scope
+    class Scope
+    {
+    public:
+        Scope() : start_(thread_allocations()) {}
+
+        /**
+         * @brief Number of allocations since the scope was created
+         */
+        uint64_t allocations() const { return thread_allocations() - start_; }
+
+    private:
+        uint64_t start_;
+    };
+
+    //! Allocations per call of an operation
+    struct Stats
+    {
+        //! Number of measured calls
+        uint64_t calls{0};
+        //! Allocations of the last call
+        uint64_t last{0};
+        //! Fewest allocations of a call, the steady-state cost
+        uint64_t min{std::numeric_limits<uint64_t>::max()};
+        //! Most allocations of a call
+        uint64_t max{0};
+        //! Allocations of all the calls
+        uint64_t total{0};
+
+        //! Add the allocations of one call
+        void add(uint64_t allocations)
+        {
+            calls++;
+            last = allocations;
+            min = std::min(min, allocations);
+            max = std::max(max, allocations);
+            total += allocations;
+        }
+    };
+} // namespace allocation_counter
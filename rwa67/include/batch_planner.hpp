@@ -0,0 +1,169 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <ariac_msgs/msg/part.hpp>
+
+#include "world_state.hpp"
+
+/**
+ * @brief Time of the moves of the robot along the rail, fitted on the executed trajectories
+ *
+ * A move of d meters takes seconds_per_move + seconds_per_meter * d. The two coefficients
+ * start from the given priors and are replaced by a least squares fit once enough moves
+ * of different lengths were recorded.
+ */
+class RailCostModel
+{
+public:
+    /**
+     * @brief Construct a new RailCostModel object
+     *
+     * @param seconds_per_move  Prior of the fixed time of a move
+     * @param seconds_per_meter  Prior of the time per meter of rail
+     * @param seconds_per_gripper_change  Time of a gripper change, trip to the tool changer included
+     */
+    RailCostModel(double seconds_per_move, double seconds_per_meter, double seconds_per_gripper_change);
+
+    /**
+     * @brief Estimated time of a move along the rail, 0 if there is no move
+     */
+    double travel(double from, double to) const;
+
+    /**
+     * @brief Estimated time of a gripper change
+     */
+    double gripper_change() const;
+
+    /**
+     * @brief Record an executed move along the rail
+     *
+     * @param distance  Distance travelled along the rail, in m
+     * @param seconds  Duration of the move
+     */
+    void record(double distance, double seconds);
+
+    /**
+     * @brief Get the number of moves recorded
+     */
+    uint64_t samples() const;
+
+    /**
+     * @brief Describe the model, e.g. "1.2 s + 0.8 s/m (12 moves)"
+     */
+    std::string report() const;
+
+private:
+    //! Refit the coefficients on the recorded moves
+    void fit_();
+
+    double seconds_per_move_;
+    double seconds_per_meter_;
+    double seconds_per_gripper_change_;
+    //! Sums of the least squares fit
+    uint64_t n_{0};
+    double sum_d_{0.0};
+    double sum_t_{0.0};
+    double sum_dd_{0.0};
+    double sum_dt_{0.0};
+};
+
+/**
+ * @brief Part of a kit to be picked from a bin and placed on a tray
+ */
+struct BatchJob
+{
+    //! Order of the kit
+    std::string order_id;
+    //! Whether the order is a priority one, its jobs come first
+    bool priority{false};
+    //! Part to pick
+    ariac_msgs::msg::Part part;
+    //! AGV carrying the tray
+    int agv_num{0};
+    //! Quadrant of the tray
+    int quadrant{0};
+    //! Rail position of the AGV
+    double place_position{0.0};
+    //! Gripper the job needs, "tray_gripper" for the job placing the tray of the kit
+    std::string gripper{"part_gripper"};
+    //! Tray to place, for a tray job
+    int tray_id{-1};
+
+    /**
+     * @brief Whether the job places the tray of its kit, which must come before the parts of the kit
+     */
+    bool is_tray() const { return gripper == "tray_gripper"; }
+};
+
+/**
+ * @brief Job of the batch, with the rail position of the bin part chosen for it
+ */
+struct BatchStep
+{
+    BatchJob job;
+    //! Rail position of the part or tray to pick, the place position if it was not found
+    double pick_position{0.0};
+    //! Whether the part was found in the bins, or the tray on a kit tray station
+    bool located{false};
+};
+
+/**
+ * @brief Order of the pick and place jobs of several kits, minimizing the time spent on the rail
+ *
+ * Each job gets the bin part of its type and color nearest to its AGV, parts being assigned
+ * at most once, or the kit tray station holding its tray. The jobs are then ordered, priority
+ * jobs first, starting with a nearest neighbor tour from the current rail position and improved
+ * by moving single jobs elsewhere in the sequence while that lowers the estimated time. Jobs of
+ * different orders are freely interleaved, so a visit of the bins can serve the kits of both
+ * AGVs of the same side. The tray of a kit is always placed before its parts.
+ *
+ * In tray-first mode, the trays of all the kits are placed first, in a single session of the
+ * tray gripper, whatever their priority, and the parts follow with a single change to the part
+ * gripper. Otherwise gripper changes are only avoided as far as their estimated time goes.
+ */
+class BatchPlanner
+{
+public:
+    /**
+     * @brief Construct a new BatchPlanner object
+     *
+     * @param cost  Time model of the moves, kept by reference
+     * @param kts1_position  Rail position of kit tray station 1
+     * @param kts2_position  Rail position of kit tray station 2
+     * @param tray_first  Whether all the trays are placed before any part
+     */
+    BatchPlanner(const RailCostModel &cost, double kts1_position, double kts2_position, bool tray_first);
+
+    /**
+     * @brief Plan the jobs of the pending kits
+     *
+     * @param jobs  Jobs to plan
+     * @param world  Parts in the bins
+     * @param rail_position  Current position of the robot on the rail
+     * @param gripper  Current gripper of the robot
+     * @param seconds  Estimated time of the rail moves and gripper changes of the sequence
+     * @return std::vector<BatchStep> Jobs in the order they should be done
+     */
+    std::vector<BatchStep> plan(const std::vector<BatchJob> &jobs, const WorldSnapshot &world,
+                                double rail_position, const std::string &gripper, double &seconds) const;
+
+    /**
+     * @brief Estimated time of a sequence of steps, huge if the part of a kit comes before its tray
+     */
+    double cost(const std::vector<BatchStep> &steps, double rail_position, const std::string &gripper) const;
+
+private:
+    //! Choose the bin part or the kit tray station of each job
+    std::vector<BatchStep> assign_(const std::vector<BatchJob> &jobs, const WorldSnapshot &world) const;
+
+    //! Order steps of the same priority, from a rail position and gripper
+    void sequence_(std::vector<BatchStep> &steps, double rail_position, const std::string &gripper) const;
+
+    const RailCostModel &cost_;
+    double kts1_position_;
+    double kts2_position_;
+    bool tray_first_;
+};
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include <rclcpp/rclcpp.hpp>
+#include <ariac_msgs/msg/advanced_logical_camera_image.hpp>
+#include <custom_msgs/msg/inventory_delta.hpp>
+#include <std_srvs/srv/trigger.hpp>
+
+#include "inventory_tracker.hpp"
+
+/**
+ * @brief Node turning the frames of the advanced logical cameras into inventory changes
+ *
+ * The cameras publish at sensor rate, mostly the same frame over and over. This node
+ * compares each frame with the previous frame of the same camera and publishes an
+ * InventoryDelta on "/rwa67/inventory_delta" only when a part or tray was added,
+ * removed or moved. Objects keep the same id across frames.
+ */
+class CameraDiff : public rclcpp::Node
+{
+public:
+    CameraDiff();
+
+private:
+    //! Number of cameras
+    static constexpr std::size_t CAMERA_COUNT = 4;
+
+    /**
+     * @brief Compare a frame with the previous one of its camera and publish the changes
+     *
+     * @param camera  Index of the camera
+     * @param msg  Frame of the camera
+     */
+    void camera_cb_(std::size_t camera, const ariac_msgs::msg::AdvancedLogicalCameraImage::ConstSharedPtr msg);
+
+    /**
+     * @brief Callback function for the service /rwa67/camera_diff/stats
+     *
+     * The message of the response reports the frames received, the frames dropped as unchanged,
+     * the deltas published and the objects seen by each camera.
+     * @param request Shared pointer to std_srvs::srv::Trigger::Request
+     * @param response Shared pointer to std_srvs::srv::Trigger::Response
+     */
+    void stats_srv_cb_(
+        std_srvs::srv::Trigger::Request::SharedPtr request,
+        std_srvs::srv::Trigger::Response::SharedPtr response);
+
+    //! Counters of a camera
+    struct CameraStats
+    {
+        uint64_t frames{0};
+        uint64_t unchanged{0};
+        uint64_t deltas{0};
+    };
+
+    //! Names of the cameras, as used in the topics
+    const std::array<std::string, CAMERA_COUNT> camera_names_{"kts1_camera", "kts2_camera", "left_bins_camera", "right_bins_camera"};
+    //! Counter of the object ids, shared by the trackers
+    std::atomic<uint32_t> next_id_{0};
+    //! Tracker of each camera
+    std::array<std::unique_ptr<InventoryTracker>, CAMERA_COUNT> trackers_;
+    //! Delta of each camera, reused across frames
+    std::array<custom_msgs::msg::InventoryDelta, CAMERA_COUNT> deltas_;
+    std::array<CameraStats, CAMERA_COUNT> stats_;
+    //! Callback group of the cameras and the stats service, so that they never run concurrently
+    rclcpp::CallbackGroup::SharedPtr cbg_;
+    std::array<rclcpp::Subscription<ariac_msgs::msg::AdvancedLogicalCameraImage>::SharedPtr, CAMERA_COUNT> camera_subs_;
+    //! Publisher for "/rwa67/inventory_delta"
+    rclcpp::Publisher<custom_msgs::msg::InventoryDelta>::SharedPtr delta_pub_;
+    //! Service to report the counters
+    rclcpp::Service<std_srvs::srv::Trigger>::SharedPtr stats_srv_;
+};
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include <geometry_msgs/msg/pose.hpp>
+#include <shape_msgs/msg/mesh.hpp>
+#include <shape_msgs/msg/solid_primitive.hpp>
+
+/**
+ * @brief Set of boxes standing in for a mesh in collision checks
+ *
+ * The boxes cover the surface of the mesh, so concave models (bins, stations)
+ * keep their openings. Poses are expressed in the frame of the mesh.
+ */
+struct CollisionProxy
+{
+    //! Boxes of the proxy
+    std::vector<shape_msgs::msg::SolidPrimitive> primitives;
+    //! Pose of each box in the mesh frame
+    std::vector<geometry_msgs::msg::Pose> primitive_poses;
+};
+
+//! Shared immutable proxy
+using CollisionProxyConstPtr = std::shared_ptr<const CollisionProxy>;
+
+/**
+ * @brief Build the box proxy of a mesh
+ *
+ * The triangles are sampled into a voxel grid of the given resolution, then the
+ * occupied voxels are greedily merged into boxes (along x, then y, then z). The
+ * proxy over-approximates the surface by at most one voxel.
+ *
+ * @param mesh  Mesh to approximate
+ * @param resolution  Edge length (in m) of the voxels
+ * @return CollisionProxy Boxes covering the surface of the mesh, empty for an empty mesh
+ */
+CollisionProxy make_box_proxy(const shape_msgs::msg::Mesh &mesh, double resolution);
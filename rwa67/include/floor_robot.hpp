@@ -31,7 +31,11 @@
 #include <moveit/move_group_interface/move_group_interface.h>
 #include <moveit/planning_scene_interface/planning_scene_interface.h>
 #include <moveit/trajectory_processing/time_optimal_trajectory_generation.h>
+#include <moveit/planning_scene_monitor/planning_scene_monitor.h>
+#include <moveit/kinematic_constraints/utils.h>
+#include <moveit/robot_state/conversions.h>
 #include <moveit_msgs/msg/collision_object.hpp>
+#include <moveit_msgs/srv/get_motion_plan.hpp>
 // Messages
 #include <geometric_shapes/shapes.h>
 #include <geometric_shapes/shape_operations.h>
@@ -71,6 +75,34 @@
 // C++
 #include <unistd.h>
 #include <cmath>
+#include <limits>
+#include <chrono>
+#include <fstream>
+#include <atomic>
+#include <condition_variable>
+#include <future>
+#include <mutex>
+#include <map>
+#include <set>
+#include <thread>
+
+#include "trajectory_cache.hpp"
+#include "motion_roadmap.hpp"
+#include "vertical_move_generator.hpp"
+#include "gripper_state_channel.hpp"
+#include "motion_profiles.hpp"
+#include "collision_proxy.hpp"
+#include "frame_pose_cache.hpp"
+#include "world_state.hpp"
+#include "order_queue.hpp"
+#include "agv_locations.hpp"
+#include "shipping_tracker.hpp"
+#include "quality_check_stage.hpp"
+#include "batch_planner.hpp"
+#include "mesh_registry.hpp"
+#include "planning_scene_builder.hpp"
+#include "scene_object_manager.hpp"
+#include "allocation_counter.hpp"
 
 // #include <competitor_interfaces/msg/floor_robot_task.hpp>
 // #include <competitor_interfaces/msg/completed_order.hpp>
@@ -192,6 +224,18 @@ private:
     rclcpp::Service<robot_commander_msgs::srv::ExitToolChanger>::SharedPtr exit_tool_changer_srv_;
     //! Service to remove a faulty part from the agv
     rclcpp::Service<custom_msgs::srv::RemovePart>::SharedPtr remove_part_srv_;
+    //! Service to report the trajectory cache counters
+    rclcpp::Service<std_srvs::srv::Trigger>::SharedPtr motion_cache_stats_srv_;
+    //! Service to report (and save) the motion profiles
+    rclcpp::Service<std_srvs::srv::Trigger>::SharedPtr motion_profiles_srv_;
+    //! Service to report the heap allocations of the motion hot path
+    rclcpp::Service<std_srvs::srv::Trigger>::SharedPtr motion_allocations_srv_;
+    //! Service to report the dynamic objects of the planning scene
+    rclcpp::Service<std_srvs::srv::Trigger>::SharedPtr scene_objects_srv_;
+    //! Service to compare planning with and without the collision proxies
+    rclcpp::Service<std_srvs::srv::Trigger>::SharedPtr benchmark_collision_proxies_srv_;
+    //! Service to compare the vertical move generator with computeCartesianPath
+    rclcpp::Service<std_srvs::srv::Trigger>::SharedPtr benchmark_vertical_moves_srv_;
 
     /**
      * @brief Callback function for the service /commander/move_robot_home
@@ -284,6 +328,82 @@ private:
     remove_part_from_agv_srv_cb_(
         custom_msgs::srv::RemovePart::Request::SharedPtr req_, custom_msgs::srv::RemovePart::Response::SharedPtr res_);
 
+    /**
+     * @brief Callback function for the service /commander/motion_cache_stats
+     *
+     * The message of the response reports the hit/miss counters of the trajectory cache
+     * and the planning time saved so far.
+     * @param req_ Shared pointer to std_srvs::srv::Trigger::Request
+     * @param res_ Shared pointer to std_srvs::srv::Trigger::Response
+     */
+    void motion_cache_stats_srv_cb_(
+        std_srvs::srv::Trigger::Request::SharedPtr req_,
+        std_srvs::srv::Trigger::Response::SharedPtr res_);
+
+    /**
+     * @brief Callback function for the service /commander/motion_profiles
+     *
+     * The message of the response reports the motion profiles and, in calibration mode, the state of the sweep.
+     * The profiles are also written to FloorRobot::motion_profiles_file_.
+     * @param req_ Shared pointer to std_srvs::srv::Trigger::Request
+     * @param res_ Shared pointer to std_srvs::srv::Trigger::Response
+     */
+    void motion_profiles_srv_cb_(
+        std_srvs::srv::Trigger::Request::SharedPtr req_,
+        std_srvs::srv::Trigger::Response::SharedPtr res_);
+
+    /**
+     * @brief Callback function for the service /commander/motion_allocations
+     *
+     * The message of the response reports the heap allocations per call of FloorRobot::move_to_target_
+     * and FloorRobot::move_through_waypoints_. The minimum is the steady-state cost.
+     * @param req_ Shared pointer to std_srvs::srv::Trigger::Request
+     * @param res_ Shared pointer to std_srvs::srv::Trigger::Response
+     */
+    void motion_allocations_srv_cb_(
+        std_srvs::srv::Trigger::Request::SharedPtr req_,
+        std_srvs::srv::Trigger::Response::SharedPtr res_);
+
+    /**
+     * @brief Callback function for the service /commander/scene_objects
+     *
+     * The message of the response reports the live object count, the objects added and removed since startup,
+     * and the state of each live object.
+     * @param req_ Shared pointer to std_srvs::srv::Trigger::Request
+     * @param res_ Shared pointer to std_srvs::srv::Trigger::Response
+     */
+    void scene_objects_srv_cb_(
+        std_srvs::srv::Trigger::Request::SharedPtr req_,
+        std_srvs::srv::Trigger::Response::SharedPtr res_);
+
+    /**
+     * @brief Callback function for the service /commander/benchmark_collision_proxies
+     *
+     * Applies the static models as full meshes, then as box proxies, and plans (without executing) the
+     * canonical motions of the commander from the current state with each: the joint-space moves to the
+     * tray tables, bins, AGVs and disposal bin, and a vertical retreat and approach. The configured
+     * geometry is restored afterwards, along with any tray or part missing from the scene. The message
+     * of the response reports the mean planning time and the success rate of each.
+     * @param req_ Shared pointer to std_srvs::srv::Trigger::Request
+     * @param res_ Shared pointer to std_srvs::srv::Trigger::Response
+     */
+    void benchmark_collision_proxies_srv_cb_(
+        std_srvs::srv::Trigger::Request::SharedPtr req_,
+        std_srvs::srv::Trigger::Response::SharedPtr res_);
+
+    /**
+     * @brief Callback function for the service /commander/benchmark_vertical_moves
+     *
+     * Plans (without executing) the vertical approach and retreat moves used by the commander from the
+     * current pose of the gripper, once with the vertical move generator and once with computeCartesianPath.
+     * The message of the response reports the planning time of both for each waypoint set.
+     * @param req_ Shared pointer to std_srvs::srv::Trigger::Request
+     * @param res_ Shared pointer to std_srvs::srv::Trigger::Response
+     */
+    void benchmark_vertical_moves_srv_cb_(
+        std_srvs::srv::Trigger::Request::SharedPtr req_,
+        std_srvs::srv::Trigger::Response::SharedPtr res_);
+
     /**
      * @brief Provide motion to the floor robot to move its base to one of the two tables.
      *
@@ -342,14 +462,157 @@ private:
 
     //=========== END PYTHON - C++ ===========//
 
+    //! Motion planned for the floor robot, ready to be executed
+    struct PlannedMotion
+    {
+        //! Time-parameterized trajectory
+        moveit_msgs::msg::RobotTrajectory trajectory;
+        //! Key of the motion in the trajectory cache, empty for joint-space motions
+        std::string cache_key;
+        //! Whether the trajectory was replayed from the trajectory cache
+        bool from_cache{false};
+        //! Time spent planning the trajectory in seconds
+        double planning_time{0.0};
+        //! Class of the motion, its outcome is reported to FloorRobot::motion_profiles_
+        MotionClass motion_class{MotionClass::FREE_TRANSIT};
+    };
+
+    //! One segment of a multi-segment motion
+    /*!
+    A segment is a joint-space motion to joint_target when waypoints is empty, a Cartesian motion through waypoints otherwise.
+    */
+    struct MotionSegment
+    {
+        //! Name of the segment, used for logging
+        std::string name;
+        //! Joint values to set on the joint value target
+        std::map<std::string, double> joint_target;
+        //! Waypoints of a Cartesian segment
+        std::vector<geometry_msgs::msg::Pose> waypoints;
+        //! Class of the segment, which sets its velocity/acceleration scaling
+        MotionClass motion_class{MotionClass::FREE_TRANSIT};
+    };
+
+    //! Buffers reused by the motions of a thread
+    /*!
+    FloorRobot::move_to_target_ and FloorRobot::move_through_waypoints_ refresh and fill these in place instead of
+    allocating a new state, plan and trajectory for every motion. Motions run from the order thread, the service
+    callbacks and the pipeline lookahead, so each thread gets its own workspace from FloorRobot::workspace_().
+    */
+    struct MotionWorkspace
+    {
+        //! Current state of the robot, refreshed in place by FloorRobot::refresh_current_state_
+        moveit::core::RobotStatePtr current_state;
+        //! Joint values of the planning group
+        std::vector<double> joint_values;
+        //! Plan of joint-space motions
+        moveit::planning_interface::MoveGroupInterface::Plan plan;
+        //! Trajectory used to retime Cartesian motions
+        robot_trajectory::RobotTrajectoryPtr retime_trajectory;
+        //! Motion being planned and executed
+        PlannedMotion motion;
+    };
+
     /**
-     * @brief Complete a single kitting task
+     * @brief Kit whose parts are all placed, holding its AGV until the verdict of its quality check
+     */
+    struct KitCheck
+    {
+        //! Kitting order
+        OrderProgress progress;
+        //! Number of checks of the kit so far, the faulty parts being replaced between two checks
+        int round{1};
+        //! Time the last check of the kit was started
+        std::chrono::steady_clock::time_point started;
+    };
+
+    /**
+     * @brief Complete a single kitting task, or the rest of it if it was preempted
+     *
+     * Between two part placements, the task handles the quality checks of the previous kits
+     * (see service_kit_checks_()) and yields to a waiting priority order (see OrderQueue::preempts).
+     * The quality check of the kit starts as soon as its last part is released, and the kit is then
+     * finished by finish_kit_().
+     * @param progress  Kitting order and parts already placed, updated as parts are placed
+     * @return true  Completed the kitting task
+     * @return false Preempted by a priority order, the task must be requeued
+     */
+    bool complete_kitting_task_(OrderProgress &progress);
+
+    /**
+     * @brief Hand over a kit whose parts are all placed and whose quality check was started
      *
-     * @param task  Kitting task to complete
-     * @return true  Successfully completed the kitting task
-     * @return false Failed to complete the kitting task
+     * The kit waits in kit_checks_, holding its AGV, while the robot moves on to the next task.
+     * @param progress  Kitting order
      */
-    bool complete_kitting_task_(ariac_msgs::msg::KittingTask task);
+    void finish_kit_(const OrderProgress &progress);
+
+    /**
+     * @brief Handle the verdicts of the kits in kit_checks_, without waiting for the pending ones
+     *
+     * Called by the order thread at its safe points, when the gripper holds nothing.
+     * The AGV of a kit that passed leaves at once. The faulty parts of a kit that failed are
+     * replaced and the kit is checked again, up to quality_check_max_rounds_ checks. A kit
+     * without a verdict after quality_check_timeout_, or whose parts cannot be replaced, is
+     * shipped as it is.
+     */
+    void service_kit_checks_();
+
+    /**
+     * @brief Handle the kits in kit_checks_ until none of them is on an AGV
+     *
+     * @param agv_num  Number of the AGV, 0 for all of them
+     */
+    void wait_kit_checks_(int agv_num);
+
+    /**
+     * @brief Handle the verdict of a kit, see service_kit_checks_()
+     *
+     * @param check  Kit waiting for its verdict, its round is updated if checked again
+     * @return true  The AGV of the kit was sent
+     * @return false The kit is still waiting for a verdict
+     */
+    bool resolve_kit_check_(KitCheck &check);
+
+    /**
+     * @brief Send the AGV of a kit to its destination, the order is submitted once it gets there
+     *
+     * @param order  Kitting order
+     */
+    void ship_kit_(const ariac_msgs::msg::Order &order);
+
+    /**
+     * @brief Replace a part that failed the quality check with a new one from the bins
+     *
+     * @param faulty  Faulty part and its location on the AGV
+     * @param check_order  Order whose kit is checked again once the part is released, nullptr unless
+     * the part is the last one replaced
+     * @return true  The new part was placed
+     * @return false Any step failed, the quadrant may be left empty
+     */
+    bool replace_faulty_part_(const FaultyPart &faulty, const ariac_msgs::msg::Order *check_order = nullptr);
+
+    /**
+     * @brief Fill the kits of all the pending orders whose AGV is free, in the order planned by batch_planner_
+     *
+     * The trays, if batch_place_trays_, and the remaining parts are planned again after each placement,
+     * with the orders received meanwhile.
+     * The quality check of each kit starts as soon as its last part is released, and the kit is then
+     * handed over to finish_kit_(). A kit whose tray or part cannot be placed stays in the batch, holding
+     * its AGV, and the step is tried again; after batch_max_failures_ failures the kit is checked and
+     * shipped as it is.
+     * @param first  Kitting order taken from the queue
+     */
+    void complete_kitting_batch_(const OrderProgress &first);
+
+    /**
+     * @brief Take from the queue the kitting orders that can join a batch
+     *
+     * Orders whose AGV is shipping, waiting for a quality check or already in the batch are put back in
+     * the queue.
+     * @param batch  Orders of the batch, extended with the orders taken
+     */
+    void collect_batch_orders_(std::vector<OrderProgress> &batch);
     //-----------------------------//
 
     /**
@@ -402,6 +665,17 @@ private:
      * @return false Failed to pick and place the tray
      */
     bool place_tray_(int tray_id, int agv_num);
+
+    /**
+     * @brief Pick a tray from a kit tray station, place it on an AGV and lock it
+     *
+     * The tray gripper is mounted first if needed, on the table of the tray.
+     * @param tray_id  Id of the tray
+     * @param agv_num  Number of the AGV
+     * @return true  Successfully placed and locked the tray
+     * @return false Failed to locate, pick or place the tray
+     */
+    bool pick_and_place_tray_(int tray_id, int agv_num);
     //-----------------------------//
 
     /**
@@ -412,6 +686,16 @@ private:
      * @return false Failed to pick the part
      */
     bool pick_bin_part_(ariac_msgs::msg::Part part_to_pick);
+
+    /**
+     * @brief Pick the part of the bins nearest to a rail position
+     *
+     * @param part_to_pick Part to pick
+     * @param rail_position Position of the linear actuator the part should be nearest to
+     * @return true  Successfully picked the part
+     * @return false Failed to pick the part
+     */
+    bool pick_bin_part_(ariac_msgs::msg::Part part_to_pick, double rail_position);
     //-----------------------------//
 
     /**
@@ -425,10 +709,12 @@ private:
      * \parblock
      *  Possible value is in the range [1,4]
      * \endparblock
+     * @param check_order Order whose kit is checked as soon as the part is released, nullptr unless the
+     * part completes the kit
      * @return true Successfully placed the part in the tray
      * @return false Failed to place the part in the tray
      */
-    bool place_part_on_tray_(int agv_num, int quadrant);
+    bool place_part_on_tray_(int agv_num, int quadrant, const ariac_msgs::msg::Order *check_order = nullptr);
     //-----------------------------//
 
     /**
@@ -445,20 +731,273 @@ private:
      * @brief Move the floor robot through waypoints
      *
      * @param waypoints  Waypoints to move through
-     * @param vsf  Velocity scale factor
-     * @param asf  Acceleration scale factor
+     * @param motion_class  Class of the motion, which sets its velocity/acceleration scaling
      * @return true  Successfully moved through the waypoints
      * @return false  Failed to move through the waypoints
      */
-    bool move_through_waypoints_(std::vector<geometry_msgs::msg::Pose> waypoints, double vsf, double asf);
+    bool move_through_waypoints_(const std::vector<geometry_msgs::msg::Pose> &waypoints, MotionClass motion_class);
+    //-----------------------------//
+
+    /**
+     * @brief Copy a state into the current state of a locked planning scene
+     *
+     * The states of the state monitor and of MoveGroupInterface do not carry the objects attached to the
+     * gripper, the current state of the planning scene does.
+     * @param scene  Locked planning scene
+     * @param state  Joint values to copy
+     * @return moveit::core::RobotState  state, with the objects attached in the planning scene
+     */
+    static moveit::core::RobotState scene_state_(const planning_scene_monitor::LockedPlanningSceneRO &scene,
+                                                 const moveit::core::RobotState &state);
+    //-----------------------------//
+
+    /**
+     * @brief Check a trajectory against the current planning scene, with the objects attached to the gripper
+     *
+     * @param trajectory Trajectory to check
+     * @param start_state Current state of the robot
+     * @param start_tolerance Maximum difference (per joint) between the first point of the trajectory and start_state
+     * @return true  The trajectory starts at start_state and is collision free
+     * @return false The trajectory cannot be executed from start_state
+     */
+    bool is_trajectory_valid_(const moveit_msgs::msg::RobotTrajectory &trajectory, const moveit::core::RobotState &start_state,
+                              double start_tolerance);
+    //-----------------------------//
+
+    /**
+     * @brief Add home, the kit tray stations, the disposal bin and the rail stations to the roadmap
+     */
+    void add_roadmap_nodes_();
+    //-----------------------------//
+
+    /**
+     * @brief Plan the paths between every pair of roadmap nodes
+     *
+     * This runs in FloorRobot::roadmap_thread_ and uses the /plan_kinematic_path service,
+     * so it does not touch the targets of the move group interface used by the services.
+     * Each pair is planned once, the edge back is the same path reversed.
+     */
+    void build_roadmap_();
+    //-----------------------------//
+
+    /**
+     * @brief Get the precomputed roadmap edge to the current joint value target
+     *
+     * The start and target only need to be within roadmap.snap_tolerance of two nodes: the ends of
+     * the edge are replaced with them, then the path is retimed with the MotionClass::FREE_TRANSIT profile.
+     * @param group  Move group interface to plan with, FloorRobot::lookahead_robot_ while FloorRobot::floor_robot_ executes
+     * @param start_state State of the robot at the start of the motion
+     * @param trajectory Roadmap edge, only set on success
+     * @return true  A valid roadmap edge leads from start_state to the target
+     * @return false The start state or the target is off-roadmap, or the edge is not valid in the current scene
+     */
+    bool plan_along_roadmap_(moveit::planning_interface::MoveGroupInterface &group, const moveit::core::RobotState &start_state,
+                             moveit_msgs::msg::RobotTrajectory &trajectory);
+    //-----------------------------//
+
+    /**
+     * @brief Plan a motion to the current joint value target
+     *
+     * The roadmap is used when possible, OMPL otherwise.
+     * @param group  Move group interface to plan with, FloorRobot::lookahead_robot_ while FloorRobot::floor_robot_ executes
+     * @param start_state State of the robot at the start of the motion
+     * @param motion Planned motion
+     * @return true  Successfully planned the motion
+     * @return false Failed to plan the motion
+     */
+    bool plan_to_target_(moveit::planning_interface::MoveGroupInterface &group, const moveit::core::RobotState &start_state,
+                         PlannedMotion &motion);
+    //-----------------------------//
+
+    /**
+     * @brief Plan a vertical approach or retreat with FloorRobot::vertical_move_generator_
+     *
+     * The generated path is checked for collisions against the monitored planning scene but not time-parameterized.
+     * @param waypoints  Waypoints to move through
+     * @param start_state State of the robot at the start of the motion
+     * @param trajectory Generated path
+     * @return true  The motion is vertical and a collision-free path was generated
+     * @return false The generic Cartesian planner must be used instead
+     */
+    bool plan_vertical_move_(const std::vector<geometry_msgs::msg::Pose> &waypoints,
+                             const moveit::core::RobotState &start_state, moveit_msgs::msg::RobotTrajectory &trajectory);
+    //-----------------------------//
+
+    /**
+     * @brief Plan a time-parameterized Cartesian motion through waypoints
+     *
+     * @param group  Move group interface to plan with, FloorRobot::lookahead_robot_ while FloorRobot::floor_robot_ executes
+     * @param waypoints  Waypoints to move through
+     * @param vsf  Velocity scale factor
+     * @param asf  Acceleration scale factor
+     * @param start_state State of the robot at the start of the motion
+     * @param motion Planned motion
+     * @param use_cache  Whether the motion is looked up in and later stored into FloorRobot::trajectory_cache_,
+     * false for motions that are stopped on the way, such as the grasp descents
+     * @return true  Successfully planned the motion
+     * @return false Failed to plan the motion
+     */
+    bool plan_through_waypoints_(moveit::planning_interface::MoveGroupInterface &group,
+                                 const std::vector<geometry_msgs::msg::Pose> &waypoints, double vsf, double asf,
+                                 const moveit::core::RobotState &start_state, PlannedMotion &motion,
+                                 bool use_cache = true);
+    //-----------------------------//
+
+    /**
+     * @brief Plan one segment of a multi-segment motion
+     *
+     * @param group  Move group interface to plan with, FloorRobot::lookahead_robot_ while FloorRobot::floor_robot_ executes
+     * @param segment Segment to plan
+     * @param start_state State of the robot at the start of the segment
+     * @param motion Planned motion
+     * @return true  Successfully planned the segment
+     * @return false Failed to plan the segment
+     */
+    bool plan_segment_(moveit::planning_interface::MoveGroupInterface &group, const MotionSegment &segment,
+                       const moveit::core::RobotState &start_state, PlannedMotion &motion);
+    //-----------------------------//
+
+    /**
+     * @brief Execute a planned motion and store it in the trajectory cache on success
+     *
+     * @param motion Motion to execute
+     * @return true  Successfully executed the motion
+     * @return false Failed to execute the motion
+     */
+    bool execute_planned_motion_(const PlannedMotion &motion);
+    //-----------------------------//
+
+    /**
+     * @brief Execute segments back to back, planning each one while the previous one executes
+     *
+     * Segment N+1 is planned with FloorRobot::lookahead_robot_ from the predicted end state of segment N,
+     * while FloorRobot::floor_robot_ executes segment N. The lookahead plan is
+     * committed only if the robot ends segment N within FloorRobot::pipeline_commit_tolerance_
+     * of the prediction, otherwise segment N+1 is replanned from the actual state.
+     * @param segments Segments to execute
+     * @return true  Successfully executed all the segments
+     * @return false Failed to plan or execute a segment
+     */
+    bool execute_motion_pipeline_(const std::vector<MotionSegment> &segments);
+    //-----------------------------//
+
+    /**
+     * @brief Move through a joint-space transit followed by a Cartesian approach
+     *
+     * Both segments are blended into one trajectory when FloorRobot::use_blending_ is set,
+     * they are executed with FloorRobot::execute_motion_pipeline_ otherwise or if blending fails.
+     * @param transit Joint-space segment
+     * @param approach Cartesian segment
+     * @return true  Successfully moved through both segments
+     * @return false Failed to move through both segments
+     */
+    bool move_transit_and_approach_(const MotionSegment &transit, const MotionSegment &approach);
+    //-----------------------------//
+
+    /**
+     * @brief Move through a joint-space transit and a Cartesian approach without stopping in between
+     *
+     * The speed ramps down to the scaling of the approach over FloorRobot::blend_ramp_time_ before the
+     * junction, the transit itself following the FREE_TRANSIT profile. TOTG rounds the corners within
+     * FloorRobot::blend_path_tolerance_, and the junction by at most half the first Cartesian step (about 5 mm).
+     * The blended trajectory is rejected if it exceeds the joint velocity or acceleration limits.
+     * @param transit Joint-space segment
+     * @param approach Cartesian segment
+     * @return true  Successfully moved through both segments
+     * @return false Failed to plan, validate or execute the blended trajectory
+     */
+    bool move_blended_(const MotionSegment &transit, const MotionSegment &approach);
+    //-----------------------------//
+
+    /**
+     * @brief Get the state of the robot at the end of a trajectory
+     *
+     * @param trajectory Trajectory of the floor robot
+     * @param reference_state State used for the joints which are not part of the trajectory
+     */
+    moveit::core::RobotState trajectory_end_state_(const moveit_msgs::msg::RobotTrajectory &trajectory,
+                                                   const moveit::core::RobotState &reference_state);
+    //-----------------------------//
+
+    /**
+     * @brief Largest difference between the joint values of the floor robot in two states
+     */
+    double joint_distance_(const moveit::core::RobotState &state1, const moveit::core::RobotState &state2);
+    //-----------------------------//
+
+    /**
+     * @brief Report the outcome of a motion to FloorRobot::motion_profiles_ during calibration
+     *
+     * The tracking error is the largest difference (per joint) between the planned and the actual end state.
+     * When the safe profile of the class changes, the profiles are written to FloorRobot::motion_profiles_file_.
+     * @param motion_class Class of the motion
+     * @param success Whether the motion succeeded
+     * @param trajectory Executed trajectory
+     */
+    void record_motion_outcome_(MotionClass motion_class, bool success, const moveit_msgs::msg::RobotTrajectory &trajectory);
+    //-----------------------------//
+
+    /**
+     * @brief Write the motion profiles to FloorRobot::motion_profiles_file_
+     */
+    void save_motion_profiles_();
+    //-----------------------------//
+
+    /**
+     * @brief Get the workspace of the calling thread, created on its first motion
+     */
+    MotionWorkspace &workspace_();
+    //-----------------------------//
+
+    /**
+     * @brief Update the workspace of the calling thread with the current state of the robot
+     *
+     * @return const moveit::core::RobotState& Current state of the robot, valid until the next call from the thread
+     */
+    const moveit::core::RobotState &refresh_current_state_();
+    //-----------------------------//
+
+    /**
+     * @brief Reset a planned motion, keeping the capacity of its buffers
+     */
+    static void reset_motion_(PlannedMotion &motion);
+    //-----------------------------//
+
+    /**
+     * @brief Log the counters of the trajectory cache
+     */
+    void log_trajectory_cache_stats_();
+    //-----------------------------//
+
+    /**
+     * @brief Add back the trays and parts of a copy of the world that are no longer in the planning scene
+     *
+     * Objects removed by scene_objects_ or attached to the gripper since the copy are left out.
+     * @param objects  World objects of the planning scene, as returned by getObjects()
+     */
+    void restore_scene_objects_(const std::map<std::string, moveit_msgs::msg::CollisionObject> &objects);
     //-----------------------------//
 
     /**
      * @brief Wait for the gripper to attach the object
      *
+     * The gripper moves down along a single slow trajectory, which FloorRobot::floor_gripper_state_cb
+     * stops as soon as the object is attached. The speed of the descent is the maximum speed of the
+     * profile of its class.
      * @param timeout Timeout in seconds
+     * @param descent_class MotionClass::GRASP_DESCENT, or MotionClass::PART_REMOVAL_DESCENT for a part in a kit tray
+     */
+    void wait_for_attach_completion_(double timeout, MotionClass descent_class = MotionClass::GRASP_DESCENT);
+    //-----------------------------//
+
+    /**
+     * @brief Slow down a trajectory so that it lasts at least a given duration
+     *
+     * Time stamps are scaled uniformly, velocities and accelerations accordingly.
+     * @param trajectory Time-parameterized trajectory
+     * @param duration Minimum duration in seconds
      */
-    void wait_for_attach_completion_(double timeout, double dz=0.001);
+    void stretch_trajectory_(moveit_msgs::msg::RobotTrajectory &trajectory, double duration);
     //-----------------------------//
 
     /**
@@ -472,10 +1011,14 @@ private:
     /**
      * @brief Get the pose of a frame in the world frame
      *
+     * The pose is served from the frame pose cache, or looked up in TF with a bounded wait.
+     *
      * @param frame_id Frame ID of the frame whose pose is to be found
-     * @return geometry_msgs::msg::Pose  Pose of the frame in the world frame
+     * @param pose  Pose of the frame in the world frame, unchanged on failure
+     * @return true if the pose was found
+     * @return false otherwise, the reason is logged
      */
-    geometry_msgs::msg::Pose get_pose_in_world_frame_(std::string frame_id);
+    bool get_pose_in_world_frame_(const std::string &frame_id, geometry_msgs::msg::Pose &pose);
     //-----------------------------//
 
     /**
@@ -491,39 +1034,170 @@ private:
     /**
      * @brief Add a single model to the planning scene
      *
+     * The mesh is taken from the mesh registry. A model already added to the scene is only moved to its new pose.
+     *
      * @param name  Name of the model
      * @param mesh_file  Mesh file of the model
      * @param model_pose  Pose of the model
      */
-    void add_single_model_to_planning_scene_(std::string name, std::string mesh_file, geometry_msgs::msg::Pose model_pose);
+    void add_single_model_to_planning_scene_(const std::string &name, const std::string &mesh_file, const geometry_msgs::msg::Pose &model_pose);
+    //-----------------------------//
+
+    /**
+     * @brief Stage a model in a batch of planning scene changes
+     *
+     * The model is added with its mesh from the mesh registry (its box proxy when use_collision_proxies_ is set),
+     * or only moved if it is already in the scene.
+     *
+     * @param builder  Batch of changes
+     * @param name  Name of the model
+     * @param mesh_file  Mesh file of the model
+     * @param model_pose  Pose of the model
+     * @return true if the model was staged
+     * @return false if its mesh is unknown
+     */
+    bool stage_model_(PlanningSceneBuilder &builder, const std::string &name, const std::string &mesh_file,
+                      const geometry_msgs::msg::Pose &model_pose);
+    //-----------------------------//
+
+    /**
+     * @brief Apply a batch of changes to the planning scene and wait for move_group to acknowledge it
+     *
+     * @param builder  Batch of changes
+     * @return true if the changes were applied (or there was none)
+     * @return false otherwise
+     */
+    bool flush_scene_(const PlanningSceneBuilder &builder);
+    //-----------------------------//
+
+    /**
+     * @brief Add a tray or part to the planning scene under a new unique id
+     *
+     * @param kind  Kind of the object, prefix of its id (e.g. "kit_tray_3", "purple_battery")
+     * @param mesh_file  Mesh file of the object
+     * @param pose  Pose of the object
+     * @return std::string Id of the object, empty if it could not be added
+     */
+    std::string add_scene_object_(const std::string &kind, const std::string &mesh_file, const geometry_msgs::msg::Pose &pose);
+    //-----------------------------//
+
+    /**
+     * @brief Attach an object of the planning scene to the gripper
+     *
+     * @param id  Id of the object, nothing is done if empty
+     */
+    void attach_scene_object_(const std::string &id);
+    //-----------------------------//
+
+    /**
+     * @brief Detach the object attached to the gripper
+     *
+     * @param location  Where the object is released, "area" or "area/slot" (e.g. "agv2", "agv2/3")
+     */
+    void detach_scene_object_(const std::string &location);
+    //-----------------------------//
+
+    /**
+     * @brief Remove the objects released in an area that left the cell
+     *
+     * @param area  Area of the objects, e.g. "agv2" or "disposal"
+     */
+    void collect_scene_objects_(const std::string &area);
+    //-----------------------------//
+
+    /**
+     * @brief Stage the static models in a batch of planning scene changes
+     *
+     * @param builder  Batch of changes
+     */
+    void stage_static_models_(PlanningSceneBuilder &builder);
     //-----------------------------//
 
     /**
      * @brief Add static models to the planning scene
      *
-     * Static models include the bins, tray tables, assembly stations, assembly inserts, and the conveyor belt
+     * Static models include the bins, tray tables, assembly stations, assembly inserts, and the conveyor belt.
+     * They are applied as a single planning scene diff, and the call returns once move_group acknowledged it.
      *
      */
     void add_models_to_planning_scene_();
     //-----------------------------//
 
-    //! Current order being processed
-    ariac_msgs::msg::Order current_order_;
-    //! List of received orders
-    std::vector<ariac_msgs::msg::Order> orders_;
+    //! Current order being processed, with its progress
+    OrderProgress current_order_;
+    //! Orders received, waiting to be processed by complete_orders_()
+    OrderQueue orders_;
+    //! Seconds complete_orders_() waits for an order before reporting that it is still waiting
+    double order_wait_timeout_;
+    //! Seconds an order waits for its AGV to reach the warehouse before it is given up
+    double agv_wait_timeout_;
     //! Move group interface for the floor robot
     moveit::planning_interface::MoveGroupInterfacePtr floor_robot_;
+    //! Move group interface planning the next segment of a pipeline while floor_robot_ executes, it is not thread-safe
+    moveit::planning_interface::MoveGroupInterfacePtr lookahead_robot_;
     //! Planning scene interface for the workcell
     moveit::planning_interface::PlanningSceneInterface planning_scene_;
+    //! Collision meshes of the workcell models
+    MeshRegistry mesh_registry_;
+    //! Names of the models added to the planning scene
+    std::set<std::string> scene_models_;
+    //! Mutex for scene_models_
+    std::mutex scene_models_mutex_;
+    //! Whether the static models are added as box proxies instead of full meshes
+    bool use_collision_proxies_;
+    //! Trays and parts added to the planning scene
+    SceneObjectManager scene_objects_{mesh_registry_};
+    //! Id of the scene object attached to the gripper, empty if none
+    std::string attached_object_id_;
     //! Trajectory processing for the floor robot
     /*!
     Generate the time-optimal trajectory along a given path within given bounds on accelerations and velocities.
     */
     trajectory_processing::TimeOptimalTrajectoryGeneration totg_;
+    //! Planning scene monitor used to validate trajectories without a round trip to move_group
+    planning_scene_monitor::PlanningSceneMonitorPtr planning_scene_monitor_;
+    //! Cache of the trajectories computed by FloorRobot::move_through_waypoints_
+    std::unique_ptr<TrajectoryCache> trajectory_cache_;
+    //! Whether FloorRobot::move_through_waypoints_ replays cached trajectories
+    bool use_trajectory_cache_;
+    //! Maximum difference (per joint) between a cached trajectory start and the current state, also the joint
+    //! resolution of the keys of trajectory_cache_
+    double trajectory_cache_start_tolerance_;
+    //! Maximum difference (per joint) between the first point of a stored trajectory and the current state
+    double roadmap_tolerance_ = 0.01;
+    //! Precomputed paths between the canonical configurations of the floor robot
+    std::unique_ptr<MotionRoadmap> roadmap_;
+    //! Whether FloorRobot::move_to_target_ uses the roadmap
+    bool use_roadmap_;
+    //! Maximum difference (per joint) between the predicted and actual end of a segment for the lookahead plan to be committed
+    double pipeline_commit_tolerance_;
+    //! Whether a rail move and the following approach are blended into one trajectory
+    bool use_blending_;
+    //! Time (in seconds) over which the speed ramps down before a blended junction
+    double blend_ramp_time_;
+    //! Path tolerance (rad) of the TOTG retiming of a blended trajectory, how far its corners may be rounded
+    double blend_path_tolerance_;
+    //! Maximum difference (per joint) between the current state and the start of a blended trajectory,
+    //! which was planned from the state before the transit
+    double blend_start_tolerance_;
+    //! Generator for vertical approach and retreat moves
+    std::unique_ptr<VerticalMoveGenerator> vertical_move_generator_;
+    //! Whether vertical moves bypass computeCartesianPath
+    bool use_vertical_moves_;
+    //! Thread building the roadmap after startup
+    std::thread roadmap_thread_;
+    //! Set when the node is destroyed to stop background threads
+    std::atomic<bool> shutting_down_{false};
+    //! Client for "/plan_kinematic_path" service
+    rclcpp::Client<moveit_msgs::srv::GetMotionPlan>::SharedPtr motion_plan_client_;
     //! Buffer used for TF2 transforms
     std::unique_ptr<tf2_ros::Buffer> tf_buffer = std::make_unique<tf2_ros::Buffer>(get_clock());
     //! TF2 listener
     std::shared_ptr<tf2_ros::TransformListener> tf_listener = std::make_shared<tf2_ros::TransformListener>(*tf_buffer);
+    //! Poses of the tool changer and AGV tray frames, invalidated when an AGV moves
+    FramePoseCache frame_pose_cache_{*tf_buffer};
+    //! Longest time (in seconds) to wait for a frame that is not cached
+    double frame_lookup_timeout_;
     //! Subscriber for "/rwa67/floor_robot/go_home" topic
     rclcpp::Subscription<std_msgs::msg::String>::SharedPtr rwa67_sub_;
     //! Subscriber for "/ariac/floor_robot_gripper_state" topic
@@ -562,41 +1236,32 @@ private:
     unsigned int competition_state_;
     //! State of the gripper.
     /*!
+        Latest ariac_msgs::msg::VacuumGripperState published by FloorRobot::floor_gripper_state_cb
         - enabled: True if the gripper is enabled.
         - attached: True if the gripper has an object attached.
         - type: Type of the gripper.
     */
-    ariac_msgs::msg::VacuumGripperState floor_gripper_state_;
+    GripperStateChannel floor_gripper_state_;
+    //! Set while the gripper moves down to grasp an object, cleared by the first attach event
+    std::atomic<bool> grasp_descent_active_{false};
+    //! Maximum distance (in m) the gripper moves down to grasp an object
+    double grasp_descent_max_depth_;
+    //! Buffers reused by the motions, one workspace per thread
+    std::map<std::thread::id, std::unique_ptr<MotionWorkspace>> workspaces_;
+    std::mutex workspaces_mutex_;
+    //! Heap allocations per call of FloorRobot::move_to_target_
+    allocation_counter::Stats move_to_target_allocations_;
+    //! Heap allocations per call of FloorRobot::move_through_waypoints_
+    allocation_counter::Stats move_through_waypoints_allocations_;
+    std::mutex allocations_mutex_;
+    //! Velocity/acceleration scaling of each class of motions
+    MotionProfileTable motion_profiles_;
+    //! Parameter file the calibrated motion profiles are written to, empty to only log them
+    std::string motion_profiles_file_;
     //! Part attached to the gripper.
     ariac_msgs::msg::Part floor_robot_attached_part_;
-    //! Pose of the camera "kts1_camera" in the world frame
-    /*!
-    \note This attribute is set in the camera callback. You can hardcode it if you prefer.
-    */
-    geometry_msgs::msg::Pose kts1_camera_pose_;
-    //! Pose of the camera "kts2_camera" in the world frame
-    /*!
-    \note This attribute is set in the camera callback. You can hardcode it if you prefer.
-    */
-    geometry_msgs::msg::Pose kts2_camera_pose_;
-    //! Pose of the camera "left_bins_camera" in the world frame
-    /*!
-    \note This attribute is set in the camera callback. You can hardcode it if you prefer.
-    */
-    geometry_msgs::msg::Pose left_bins_camera_pose_;
-    //! Pose of the camera "right_bins_camera" in the world frame
-    /*!
-    \note This attribute is set in the camera callback. You can hardcode it if you prefer.
-    */
-    geometry_msgs::msg::Pose right_bins_camera_pose_;
-    //! Pose of trays found by "kts1_camera"
-    std::vector<ariac_msgs::msg::KitTrayPose> kts1_trays_;
-    //! Pose of trays found by "kts2_camera"
-    std::vector<ariac_msgs::msg::KitTrayPose> kts2_trays_;
-    //! Pose of trays found by "left_bins_camera"
-    std::vector<ariac_msgs::msg::PartPose> left_bins_parts_;
-    //! Pose of trays found by "right_bins_camera"
-    std::vector<ariac_msgs::msg::PartPose> right_bins_parts_;
+    //! Latest frames of the cameras, published by the camera callbacks
+    WorldState world_;
     //! Callback group for the subscriptions
     rclcpp::CallbackGroup::SharedPtr subscription_cbg_;
     //! Specific callback group for the state of the gripper
@@ -633,9 +1298,53 @@ private:
     void agv3_status_cb(const ariac_msgs::msg::AGVStatus::ConstSharedPtr msg);
     //! Callback for "/ariac/agv4_status" topic
     void agv4_status_cb(const ariac_msgs::msg::AGVStatus::ConstSharedPtr msg);
+    /**
+     * @brief Record the location of an AGV reported by its status topic
+     *
+     * A change of location invalidates the cached pose of the AGV tray frame. Trays and parts left on an
+     * AGV that is not at the kitting station are removed from the planning scene.
+     *
+     * @param agv_num  Number of the AGV
+     * @param location  Location of the AGV, see agv_locations_
+     */
+    void update_agv_location_(int agv_num, int location);
+    /**
+     * @brief Report the outcome of a shipment, called by the worker threads of shipping_
+     *
+     * Submitted orders are published on "/ariac/submitted_order".
+     *
+     * @param order_id  Id of the order
+     * @param agv_num  Number of the AGV carrying the order
+     * @param submitted  Whether the order was submitted
+     */
+    void report_shipment_(const std::string &order_id, int agv_num, bool submitted);
+    //! Publisher for "/ariac/submitted_order"
+    rclcpp::Publisher<std_msgs::msg::String>::SharedPtr submitted_order_pub_;
 
     //! Client for "/ariac/perform_quality_check" service
     rclcpp::Client<ariac_msgs::srv::PerformQualityCheck>::SharedPtr quality_checker_;
+    //! Callback group of quality_checker_, so that its responses are not blocked by the order thread
+    rclcpp::CallbackGroup::SharedPtr quality_cbg_;
+    //! Quality checks of the kits, sent through quality_checker_
+    std::unique_ptr<QualityCheckStage> quality_checks_;
+    //! Seconds a kit waits for the result of its quality check before being shipped as it is
+    double quality_check_timeout_;
+    //! Seconds the order thread blocks on a quality check before handling the other kits and orders again
+    double quality_check_poll_period_;
+    //! Kits waiting for the verdict of their quality check, only used by the order thread
+    std::vector<KitCheck> kit_checks_;
+    //! Number of quality checks of a kit, the faulty parts being replaced between two checks
+    int quality_check_max_rounds_;
+    //! Whether the kits of the pending orders are planned together, see complete_kitting_batch_()
+    bool batch_planning_;
+    //! Whether complete_kitting_batch_() places the trays of the kits, or expects them on the AGVs
+    bool batch_place_trays_;
+    //! Number of failed placements after which complete_kitting_batch_() ships a kit as it is
+    int batch_max_failures_;
+    //! Time model of the rail moves, refined by record_motion_outcome_()
+    std::unique_ptr<RailCostModel> rail_costs_;
+    //! Planner of the parts of the pending kits, using rail_costs_
+    std::unique_ptr<BatchPlanner> batch_planner_;
     //! Client for "/ariac/floor_robot_change_gripper" service
     rclcpp::Client<ariac_msgs::srv::ChangeGripper>::SharedPtr floor_robot_tool_changer_;
     //! Client for "/ariac/floor_robot_enable_gripper" service
@@ -714,12 +1423,18 @@ private:
         {"floor_wrist_3_joint", 0.0}};    
     //! AGV locations for different AGVs.
     /*!
-        The first value is the AGV number and the second value is the location of the AGV, the latter can be one of the following:
+        Set by the AGV status callbacks, awaited by complete_orders_(). The location of an AGV is -1 until it reports, then one of the following:
         - KITTING=0
         - ASSEMBLY_FRONT=1
         - ASSEMBLY_BACK=2
         - WAREHOUSE=3
         - UNKNOWN=99
     */
-    std::map<int, int> agv_locations_ = {{1, -1}, {2, -1}, {3, -1}, {4, -1}};
+    AgvLocations agv_locations_{4};
+    //! Orders waiting for their AGV to reach the warehouse, declared after agv_locations_ which it uses
+    ShippingTracker shipping_{agv_locations_,
+                              [this](const std::string &order_id)
+                              { return submit_order_(order_id); },
+                              [this](const std::string &order_id, int agv_num, bool submitted)
+                              { report_shipment_(order_id, agv_num, submitted); }};
 };
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <string>
+
+#include <geometry_msgs/msg/pose.hpp>
+#include "tf2_ros/buffer.h"
+
+/**
+ * @brief Reason a frame lookup failed
+ */
+enum class FrameLookupError
+{
+    //! The lookup succeeded
+    NONE,
+    //! The frame is not known to TF
+    UNKNOWN_FRAME,
+    //! The frame is not connected to the reference frame
+    DISCONNECTED,
+    //! No transform at the requested time
+    EXTRAPOLATION,
+    //! The transform did not become available within the timeout
+    TIMEOUT,
+    //! Any other TF error
+    OTHER
+};
+
+/**
+ * @brief Outcome of a frame lookup: a pose, or the reason there is none
+ */
+struct FrameLookup
+{
+    //! Pose of the frame in the reference frame, empty on failure
+    std::optional<geometry_msgs::msg::Pose> pose;
+    FrameLookupError error{FrameLookupError::NONE};
+    //! Message of the TF exception, empty on success
+    std::string message;
+    //! Whether the pose was served from the cache
+    bool cached{false};
+
+    explicit operator bool() const { return pose.has_value(); }
+};
+
+/**
+ * @brief Cache of the poses of frames that only move at discrete events
+ *
+ * The tool changer frames never move and the AGV tray frames only move when an
+ * AGV leaves or reaches a station. Their poses are looked up in TF once, with a
+ * bounded wait, and served from the cache until the frame is invalidated.
+ * Failed lookups are not cached.
+ */
+class FramePoseCache
+{
+public:
+    //! Lookup counters
+    struct Stats
+    {
+        //! Lookups served from the cache
+        uint64_t hits{0};
+        //! Lookups sent to TF
+        uint64_t lookups{0};
+        //! Lookups that failed
+        uint64_t failures{0};
+    };
+
+    /**
+     * @brief Construct a new Frame Pose Cache object
+     *
+     * @param buffer  TF buffer, filled by a listener spinning in its own thread
+     * @param reference_frame  Frame the poses are expressed in
+     */
+    explicit FramePoseCache(tf2_ros::Buffer &buffer, const std::string &reference_frame = "world");
+
+    /**
+     * @brief Get the pose of a frame
+     *
+     * @param frame  Frame to look up
+     * @param timeout  Longest time (in seconds) to wait for the transform when it is not cached
+     * @return FrameLookup The pose, or the reason of the failure
+     */
+    FrameLookup lookup(const std::string &frame, double timeout);
+
+    /**
+     * @brief Drop the cached pose of a frame
+     */
+    void invalidate(const std::string &frame);
+
+    /**
+     * @brief Drop all the cached poses
+     */
+    void clear();
+
+    /**
+     * @brief Get the lookup counters
+     */
+    Stats stats() const;
+
+    /**
+     * @brief Name of a lookup error, for log messages
+     */
+    static std::string error_name(FrameLookupError error);
+
+private:
+    tf2_ros::Buffer &buffer_;
+    std::string reference_frame_;
+    std::map<std::string, geometry_msgs::msg::Pose> poses_;
+    Stats stats_;
+    //! Incremented by every invalidation
+    uint64_t generation_{0};
+    mutable std::mutex mutex_;
+};
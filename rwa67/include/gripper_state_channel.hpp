@@ -0,0 +1,77 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+
+#include <ariac_msgs/msg/vacuum_gripper_state.hpp>
+
+/**
+ * @brief Latest state of the vacuum gripper, shared between the gripper callback and the motion threads
+ *
+ * The gripper callback publishes each new state as an immutable snapshot. Readers get
+ * the latest snapshot without blocking the callback, and threads that need a given
+ * state (object attached, gripper enabled) block until it is published or a deadline
+ * expires instead of polling.
+ */
+class GripperStateChannel
+{
+public:
+    //! Immutable state of the gripper
+    using Snapshot = std::shared_ptr<const ariac_msgs::msg::VacuumGripperState>;
+    //! Condition on the state of the gripper
+    using Predicate = std::function<bool(const ariac_msgs::msg::VacuumGripperState &)>;
+
+    /**
+     * @brief Construct a new GripperStateChannel object
+     *
+     * The initial snapshot is a disabled gripper with nothing attached.
+     */
+    GripperStateChannel();
+
+    /**
+     * @brief Publish a new state of the gripper and wake up the waiting threads
+     */
+    void publish(const ariac_msgs::msg::VacuumGripperState &state);
+
+    /**
+     * @brief Get the latest state of the gripper
+     */
+    Snapshot snapshot() const;
+
+    /**
+     * @brief Block until the state of the gripper satisfies a predicate
+     *
+     * @param predicate Condition on the state of the gripper
+     * @param timeout Timeout in seconds
+     * @return true  The latest state satisfies the predicate
+     * @return false The timeout expired first
+     */
+    bool wait_for(const Predicate &predicate, double timeout) const;
+
+    /**
+     * @brief Block until an object is attached to the gripper
+     *
+     * @param timeout Timeout in seconds
+     * @return true  An object is attached
+     * @return false The timeout expired first
+     */
+    bool wait_until_attached(double timeout) const;
+
+    /**
+     * @brief Block until the gripper is enabled, or disabled with the object it held released
+     *
+     * @param enabled Expected state of the gripper
+     * @param timeout Timeout in seconds
+     * @return true  The gripper is in the expected state
+     * @return false The timeout expired first
+     */
+    bool wait_until_enabled(bool enabled, double timeout) const;
+
+private:
+    Snapshot snapshot_;
+    mutable std::mutex mutex_;
+    mutable std::condition_variable changed_;
+};
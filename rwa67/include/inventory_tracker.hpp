@@ -0,0 +1,70 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+#include <ariac_msgs/msg/advanced_logical_camera_image.hpp>
+#include <custom_msgs/msg/inventory_delta.hpp>
+#include <custom_msgs/msg/inventory_item.hpp>
+
+/**
+ * @brief Parts and trays seen by one camera, turned into changes between frames
+ *
+ * Each frame is first hashed, with its poses quantized to the move tolerance: a
+ * frame with the same hash as the previous one is dropped without further work.
+ * Otherwise the objects of the frame are matched with the tracked ones (same type
+ * and color, or same tray id, nearest within the match distance). Unmatched objects
+ * of the frame are added with a new id, unmatched tracked objects are removed and
+ * matched objects that moved more than the move tolerance are reported as moved.
+ */
+class InventoryTracker
+{
+public:
+    /**
+     * @brief Construct a new Inventory Tracker object
+     *
+     * @param next_id  Counter of the object ids, shared by the trackers of all cameras
+     * @param match_distance  Largest distance (in m) between two poses of the same object in successive frames
+     * @param move_tolerance  Smallest distance (in m) reported as a move
+     */
+    InventoryTracker(std::atomic<uint32_t> &next_id, double match_distance, double move_tolerance);
+
+    /**
+     * @brief Compare a frame with the previous one
+     *
+     * @param image  Frame of the camera
+     * @param delta  Filled with the changes (header and camera are left to the caller)
+     * @return true if something changed
+     * @return false if the frame is the same as the previous one
+     */
+    bool update(const ariac_msgs::msg::AdvancedLogicalCameraImage &image, custom_msgs::msg::InventoryDelta &delta);
+
+    /**
+     * @brief Get the number of objects seen in the last frame
+     */
+    std::size_t size() const;
+
+private:
+    //! Object of the previous frame
+    struct Tracked
+    {
+        custom_msgs::msg::InventoryItem item;
+        bool matched{false};
+    };
+
+    //! Hash of a frame, with the poses quantized to the move tolerance
+    uint64_t hash_(const ariac_msgs::msg::AdvancedLogicalCameraImage &image) const;
+
+    //! Match an object of the frame with the tracked objects and record the change
+    void match_(const custom_msgs::msg::InventoryItem &item, custom_msgs::msg::InventoryDelta &delta);
+
+    std::atomic<uint32_t> &next_id_;
+    double match_distance_;
+    double move_tolerance_;
+    std::vector<Tracked> tracked_;
+    //! Objects of the frame being processed, reused across frames
+    std::vector<Tracked> current_;
+    uint64_t last_hash_{0};
+    bool has_frame_{false};
+};
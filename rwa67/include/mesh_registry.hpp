@@ -0,0 +1,66 @@
+#pragma once
+
+#include <map>
+#include <memory>
+#include <string>
+
+#include <shape_msgs/msg/mesh.hpp>
+
+#include "collision_proxy.hpp"
+
+/**
+ * @brief Collision meshes of the workcell models, loaded once
+ *
+ * Every mesh file of a directory is parsed at startup and converted to a
+ * shape_msgs::msg::Mesh. Meshes are then handed out as shared immutable references,
+ * so adding a model to the planning scene no longer touches the file system.
+ * Box proxies of the meshes can be built once, for cheaper collision checks.
+ * The registry is read-only once loaded.
+ */
+class MeshRegistry
+{
+public:
+    //! Shared immutable mesh
+    using MeshConstPtr = std::shared_ptr<const shape_msgs::msg::Mesh>;
+
+    /**
+     * @brief Load every mesh file (.stl, .dae, .obj) of a directory
+     *
+     * @param directory Directory containing the mesh files
+     * @return std::size_t Number of meshes loaded
+     */
+    std::size_t load_directory(const std::string &directory);
+
+    /**
+     * @brief Get a mesh
+     *
+     * @param mesh_file Name of the mesh file, e.g. "kit_tray.stl"
+     * @return MeshConstPtr The mesh, nullptr if the file was not loaded
+     */
+    MeshConstPtr get(const std::string &mesh_file) const;
+
+    /**
+     * @brief Build the box proxy of every loaded mesh
+     *
+     * @param resolution Edge length (in m) of the voxels the meshes are sampled into
+     * @return std::size_t Total number of boxes of the proxies
+     */
+    std::size_t build_proxies(double resolution);
+
+    /**
+     * @brief Get the box proxy of a mesh
+     *
+     * @param mesh_file Name of the mesh file, e.g. "bin.stl"
+     * @return CollisionProxyConstPtr The proxy, nullptr if it was not built
+     */
+    CollisionProxyConstPtr proxy(const std::string &mesh_file) const;
+
+    /**
+     * @brief Get the number of loaded meshes
+     */
+    std::size_t size() const;
+
+private:
+    std::map<std::string, MeshConstPtr> meshes_;
+    std::map<std::string, CollisionProxyConstPtr> proxies_;
+};
@@ -0,0 +1,144 @@
+#pragma once
+
+#include <array>
+#include <mutex>
+#include <string>
+
+/**
+ * @brief Classes of motions of the floor robot sharing the same velocity/acceleration scaling
+ */
+enum class MotionClass
+{
+    //! Joint-space motion (rail moves, home)
+    FREE_TRANSIT,
+    //! Cartesian motion with nothing attached to the gripper
+    APPROACH,
+    //! Cartesian motion carrying a part
+    APPROACH_WITH_PART,
+    //! Cartesian motion carrying a tray
+    APPROACH_WITH_TRAY,
+    //! Slow descent until the gripper attaches an object
+    GRASP_DESCENT,
+    //! Cartesian motion away from a pick or place location
+    RETREAT,
+    //! Faster grasp descent onto a part lying in a kit tray
+    PART_REMOVAL_DESCENT,
+    //! Vertical motion raising the gripper after a grasp or out of a tool changer
+    LIFT,
+    //! Vertical motion raising a tray off its table
+    TRAY_LIFT,
+    //! Motion into and out of the tool changer while the gripper is swapped
+    TOOL_CHANGE
+};
+
+//! Velocity/acceleration scaling of a class of motions
+struct MotionProfile
+{
+    //! Velocity scale factor
+    double vsf{1.0};
+    //! Acceleration scale factor
+    double asf{1.0};
+    //! Maximum Cartesian speed of the gripper (in m/s), 0 for no limit
+    double max_speed{0.0};
+};
+
+/**
+ * @brief Table of motion profiles, keyed by motion class
+ *
+ * In calibration mode the table sweeps the profile of each class upwards: every
+ * motion of a class runs with the current candidate profile and reports whether it
+ * succeeded (the object stayed attached, or got attached for a grasp descent) and
+ * its tracking error. A candidate that succeeded a given number of times becomes
+ * the safe profile of the class and the next, faster, candidate is tried. The sweep
+ * of a class ends at its first failure or once the scaling factors reach 1.0.
+ */
+class MotionProfileTable
+{
+public:
+    //! Number of motion classes
+    static constexpr std::size_t CLASS_COUNT = 10;
+
+    /**
+     * @brief Name of a motion class, as used in the parameter file
+     */
+    static std::string class_name(MotionClass motion_class);
+
+    /**
+     * @brief Set the profile of a class (the safe profile during calibration)
+     */
+    void set_profile(MotionClass motion_class, const MotionProfile &profile);
+
+    /**
+     * @brief Get the profile a motion of a class should use
+     *
+     * @return MotionProfile The candidate profile during calibration, the configured one otherwise
+     */
+    MotionProfile profile(MotionClass motion_class) const;
+
+    /**
+     * @brief Start sweeping the profiles of all classes
+     *
+     * @param step  Increment of the multiplier applied to the safe profile at each candidate
+     * @param max_multiplier  Largest multiplier tried
+     * @param trials  Number of successful motions needed to validate a candidate
+     * @param max_tracking_error  Largest tracking error (per joint) of a successful motion
+     */
+    void start_calibration(double step, double max_multiplier, int trials, double max_tracking_error);
+
+    /**
+     * @brief Whether the profiles are being swept
+     */
+    bool calibrating() const;
+
+    /**
+     * @brief Report the outcome of a motion
+     *
+     * @param motion_class  Class of the motion
+     * @param success  Whether the motion succeeded
+     * @param tracking_error  Largest difference (per joint) between the planned and actual end states
+     * @return true  The safe profile of the class changed or its sweep ended
+     * @return false Nothing changed (or the table is not calibrating)
+     */
+    bool record(MotionClass motion_class, bool success, double tracking_error);
+
+    /**
+     * @brief Write the safe profiles as a ROS 2 parameter file
+     *
+     * @param node_name  Name of the node the parameters belong to
+     * @return std::string Content of the parameter file
+     */
+    std::string to_yaml(const std::string &node_name) const;
+
+    /**
+     * @brief Describe the profiles and the state of the sweep
+     */
+    std::string report() const;
+
+private:
+    //! Sweep state of a class
+    struct Calibration
+    {
+        //! Whether the class is still being swept
+        bool active{false};
+        //! Multiplier of the candidate profile, relative to the profile at the start of the calibration
+        double multiplier{1.0};
+        //! Successful motions with the candidate profile
+        int successes{0};
+        //! Largest tracking error measured with the candidate profile
+        double max_tracking_error{0.0};
+    };
+
+    //! Profile scaled by a multiplier, the scale factors being capped to 1.0
+    static MotionProfile scaled_(const MotionProfile &profile, double multiplier);
+
+    //! Safe profile of each class
+    std::array<MotionProfile, CLASS_COUNT> profiles_;
+    //! Profile of each class when the calibration started, candidates are multiples of it
+    std::array<MotionProfile, CLASS_COUNT> base_profiles_;
+    std::array<Calibration, CLASS_COUNT> calibration_;
+    double step_{0.25};
+    double max_multiplier_{4.0};
+    int trials_{3};
+    double max_tracking_error_{0.01};
+    mutable std::mutex mutex_;
+};
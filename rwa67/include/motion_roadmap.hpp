@@ -0,0 +1,90 @@
+#pragma once
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <moveit_msgs/msg/robot_trajectory.hpp>
+
+/**
+ * @brief Roadmap of precomputed trajectories between named joint configurations
+ *
+ * The floor robot shuttles between a small, fixed set of configurations (home, the
+ * kit tray stations, the rail stations in front of the AGVs and bins). Each node of
+ * the roadmap is one of these configurations and each edge is a collision-checked
+ * path from one node to another, to be retimed by the caller.
+ *
+ * Joint values are stored in the variable order of the planning group.
+ */
+class MotionRoadmap
+{
+public:
+    /**
+     * @brief Construct a new MotionRoadmap object
+     *
+     * @param tolerance Maximum difference (per joint) between a joint configuration and a node for them to match
+     */
+    explicit MotionRoadmap(double tolerance = 0.01);
+
+    /**
+     * @brief Add a node to the roadmap
+     *
+     * @param name  Name of the node
+     * @param joint_values  Joint values of the node
+     * @return true  The node was added
+     * @return false A node with the same name or the same joint values already exists
+     */
+    bool add_node(const std::string &name, const std::vector<double> &joint_values);
+
+    /**
+     * @brief Get the names of all the nodes
+     */
+    std::vector<std::string> node_names() const;
+
+    /**
+     * @brief Get the joint values of a node
+     *
+     * @param name  Name of the node
+     * @param joint_values  Joint values of the node, only set if the node exists
+     * @return true  The node exists
+     * @return false The node does not exist
+     */
+    bool get_node(const std::string &name, std::vector<double> &joint_values) const;
+
+    /**
+     * @brief Find the node closest to a joint configuration
+     *
+     * @param joint_values  Joint configuration
+     * @return std::string  Name of the closest node within tolerance, empty if there is none
+     */
+    std::string nearest_node(const std::vector<double> &joint_values) const;
+
+    /**
+     * @brief Store the trajectory between two nodes
+     */
+    void set_edge(const std::string &from, const std::string &to, const moveit_msgs::msg::RobotTrajectory &trajectory);
+
+    /**
+     * @brief Get the trajectory between two nodes
+     *
+     * @return true  An edge exists between the two nodes
+     * @return false No edge exists between the two nodes
+     */
+    bool get_edge(const std::string &from, const std::string &to, moveit_msgs::msg::RobotTrajectory &trajectory) const;
+
+    /**
+     * @brief Get the number of edges
+     */
+    std::size_t edge_count() const;
+
+private:
+    //! Largest difference between the joint values of two configurations
+    static double max_joint_difference_(const std::vector<double> &a, const std::vector<double> &b);
+
+    double tolerance_;
+    std::map<std::string, std::vector<double>> nodes_;
+    std::map<std::pair<std::string, std::string>, moveit_msgs::msg::RobotTrajectory> edges_;
+    mutable std::mutex mutex_;
+};
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include <ariac_msgs/msg/order.hpp>
+
+#include "wait_result.hpp"
+
+/**
+ * @brief Order being processed, with what was done of it so far
+ *
+ * An order preempted between two part placements goes back to the queue with its
+ * progress, and is resumed from the first part not placed yet.
+ */
+struct OrderProgress
+{
+    //! Order as announced
+    ariac_msgs::msg::Order order;
+    //! Number of parts of the kit already placed on the tray
+    std::size_t parts_placed{0};
+    //! Whether the tray of the kit was placed by the batch planner
+    bool tray_placed{false};
+    //! Rank of the order in the announcements, kept when it is requeued
+    uint64_t arrival{0};
+    //! Number of times the order was preempted
+    unsigned int preemptions{0};
+    //! Number of trays or parts of the kit the batch planner failed to place
+    unsigned int failures{0};
+};
+
+/**
+ * @brief Orders received by the order callback, waiting to be processed by the order thread
+ *
+ * The callback pushes the orders and the order thread blocks until one is available,
+ * instead of polling. Priority orders are popped first, then the others in the order
+ * of their announcement, preempted orders included. Once the announcements are done,
+ * the queue is drained: popping from it when it is empty returns at once. Cancelling
+ * the queue, when the competition ends, wakes up the order thread for good, even if
+ * orders are left.
+ */
+class OrderQueue
+{
+public:
+    /**
+     * @brief Add a new order to the queue and wake up the order thread
+     */
+    void push(const ariac_msgs::msg::Order &order);
+
+    /**
+     * @brief Put back a preempted order, with its progress and its rank
+     */
+    void requeue(const OrderProgress &progress);
+
+    /**
+     * @brief Block until an order is available and take the most urgent one
+     *
+     * A new kit for an AGV whose tray holds a preempted kit waits for that kit to be completed.
+     * @param progress  Order taken, unchanged if there is none
+     * @param timeout  Timeout in seconds
+     * @return WaitResult READY if an order was taken, TIMEOUT, DRAINED or CANCELLED otherwise
+     */
+    WaitResult pop(OrderProgress &progress, double timeout);
+
+    /**
+     * @brief Tell whether a waiting order should preempt the one being processed
+     *
+     * A regular order is preempted by any waiting priority order, except the kits for its own AGV.
+     * @param current  Order being processed
+     * @return true if the order thread should put the current order back and pop again
+     * @return false otherwise
+     */
+    bool preempts(const OrderProgress &current) const;
+
+    /**
+     * @brief Mark the end of the announcements: no order will be pushed anymore
+     */
+    void drain();
+
+    /**
+     * @brief Wake up the order thread and make every later pop fail
+     */
+    void cancel();
+
+    /**
+     * @brief Get the number of orders waiting
+     */
+    std::size_t size() const;
+
+private:
+    //! Ordering of the queue: true if a is less urgent than b
+    struct LessUrgent
+    {
+        bool operator()(const OrderProgress &a, const OrderProgress &b) const;
+    };
+
+    //! Kits for the same AGV
+    static bool same_agv_(const OrderProgress &a, const OrderProgress &b);
+    //! Whether an order is a new kit for an AGV holding a preempted kit, called with mutex_ held
+    bool blocked_(const OrderProgress &progress) const;
+
+    //! Heap ordered by LessUrgent, the most urgent order first
+    std::vector<OrderProgress> orders_;
+    uint64_t next_arrival_{0};
+    bool drained_{false};
+    bool cancelled_{false};
+    mutable std::mutex mutex_;
+    std::condition_variable changed_;
+};
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <array>
+#include <vector>
+
+#include <geometry_msgs/msg/pose.hpp>
+#include <ariac_msgs/msg/part.hpp>
+
+/**
+ * @brief Parts seen by a camera, indexed by (type, color)
+ *
+ * Poses are in the world frame. There is one slot per (type, color), so getting
+ * the parts of a type and color is a direct array access. Clearing keeps the
+ * capacity of the slots, so that refilling the inventory every camera frame does
+ * not allocate once the slots have grown.
+ */
+class PartInventory
+{
+public:
+    //! Number of part types (battery, pump, sensor, regulator)
+    static constexpr std::size_t TYPE_COUNT = 4;
+    //! Number of part colors (red, green, blue, orange, purple)
+    static constexpr std::size_t COLOR_COUNT = 5;
+
+    /**
+     * @brief Remove all the parts, keeping the capacity of the slots
+     */
+    void clear();
+
+    /**
+     * @brief Add a part
+     *
+     * @param part  Type and color of the part, ignored if unknown
+     * @param world_pose  Pose of the part in the world frame
+     */
+    void add(const ariac_msgs::msg::Part &part, const geometry_msgs::msg::Pose &world_pose);
+
+    /**
+     * @brief Get the world poses of the parts of a type and color
+     *
+     * @return const std::vector<geometry_msgs::msg::Pose>& Poses, empty for an unknown type or color
+     */
+    const std::vector<geometry_msgs::msg::Pose> &parts(uint8_t type, uint8_t color) const;
+
+    /**
+     * @brief Find the part of a type and color nearest to a position of the rail
+     *
+     * The rail position of a part is the position of the linear actuator above it, i.e. -y.
+     *
+     * @param type  Type of the part
+     * @param color  Color of the part
+     * @param rail_position  Position of the linear actuator
+     * @param pose  World pose of the nearest part, unchanged if there is none
+     * @param distance  Distance along the rail to the nearest part, unchanged if there is none
+     * @return true if a part was found
+     * @return false otherwise
+     */
+    bool nearest(uint8_t type, uint8_t color, double rail_position,
+                 geometry_msgs::msg::Pose &pose, double &distance) const;
+
+    /**
+     * @brief Get the number of parts
+     */
+    std::size_t size() const;
+
+private:
+    //! Slot of a (type, color), -1 if either is unknown
+    static int slot_(uint8_t type, uint8_t color);
+
+    std::array<std::vector<geometry_msgs::msg::Pose>, TYPE_COUNT * COLOR_COUNT> slots_;
+    std::size_t size_{0};
+};
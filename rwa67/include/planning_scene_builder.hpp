@@ -0,0 +1,98 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <geometry_msgs/msg/pose.hpp>
+#include <moveit_msgs/msg/collision_object.hpp>
+#include <moveit_msgs/msg/planning_scene.hpp>
+#include <shape_msgs/msg/mesh.hpp>
+#include <shape_msgs/msg/solid_primitive.hpp>
+
+/**
+ * @brief Batch of collision object changes sent to move_group as a single planning scene diff
+ *
+ * Changes are staged with add_mesh, add_primitives, move and remove, then turned into one
+ * moveit_msgs::msg::PlanningScene diff with build(). Applying that diff with
+ * PlanningSceneInterface::applyPlanningScene costs one round trip whatever the
+ * number of objects. The builder can be cleared and reused for the next batch.
+ */
+class PlanningSceneBuilder
+{
+public:
+    /**
+     * @brief Construct a new Planning Scene Builder object
+     *
+     * @param frame_id Frame the object poses are expressed in
+     */
+    explicit PlanningSceneBuilder(const std::string &frame_id = "world");
+
+    /**
+     * @brief Stage the addition of a mesh object
+     *
+     * The mesh is placed through the object pose, so that the object can later be moved with a pose update only.
+     *
+     * @param id  Id of the object
+     * @param mesh  Mesh of the object
+     * @param pose  Pose of the object
+     */
+    void add_mesh(const std::string &id, const shape_msgs::msg::Mesh &mesh, const geometry_msgs::msg::Pose &pose);
+
+    /**
+     * @brief Stage the addition of an object made of primitives
+     *
+     * @param id  Id of the object
+     * @param primitives  Primitives of the object
+     * @param primitive_poses  Pose of each primitive, relative to the object pose
+     * @param pose  Pose of the object
+     */
+    void add_primitives(const std::string &id, const std::vector<shape_msgs::msg::SolidPrimitive> &primitives,
+                        const std::vector<geometry_msgs::msg::Pose> &primitive_poses, const geometry_msgs::msg::Pose &pose);
+
+    /**
+     * @brief Stage the move of an object already in the scene
+     *
+     * @param id  Id of the object
+     * @param pose  New pose of the object
+     */
+    void move(const std::string &id, const geometry_msgs::msg::Pose &pose);
+
+    /**
+     * @brief Stage the removal of an object from the scene
+     *
+     * @param id  Id of the object
+     */
+    void remove(const std::string &id);
+
+    /**
+     * @brief Staged changes, as collision objects
+     */
+    const std::vector<moveit_msgs::msg::CollisionObject> &collision_objects() const;
+
+    /**
+     * @brief Build the planning scene diff of the staged changes
+     */
+    moveit_msgs::msg::PlanningScene build() const;
+
+    /**
+     * @brief Whether no change is staged
+     */
+    bool empty() const;
+
+    /**
+     * @brief Number of staged changes
+     */
+    std::size_t size() const;
+
+    /**
+     * @brief Drop the staged changes
+     */
+    void clear();
+
+private:
+    //! Staged collision object with the header and id set
+    moveit_msgs::msg::CollisionObject &stage_(const std::string &id, const geometry_msgs::msg::Pose &pose);
+
+    std::string frame_id_;
+    std::vector<moveit_msgs::msg::CollisionObject> collision_objects_;
+};
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <rclcpp/rclcpp.hpp>
+#include <ariac_msgs/msg/kitting_task.hpp>
+#include <ariac_msgs/msg/part.hpp>
+#include <ariac_msgs/srv/perform_quality_check.hpp>
+
+#include "wait_result.hpp"
+
+/**
+ * @brief Part of a kit found faulty, to be removed from the tray and replaced
+ */
+struct FaultyPart
+{
+    //! Order of the kit
+    std::string order_id;
+    //! AGV carrying the kit
+    int agv_num{0};
+    //! Quadrant of the tray holding the part
+    int quadrant{0};
+    //! Type and color of the part, as requested by the kit
+    ariac_msgs::msg::Part part;
+};
+
+/**
+ * @brief Quality checks of the kits, running while the robot moves on
+ *
+ * A check is sent as soon as the last part of a kit is released and its response is
+ * handled by the executor: the faulty parts it reports are queued as removal tasks
+ * and the verdict is stored. The order thread picks up the verdicts and the removal
+ * tasks at its safe points, between two parts or two orders, and only blocks on a
+ * verdict when it needs the AGV of the kit.
+ */
+class QualityCheckStage
+{
+public:
+    /**
+     * @brief Construct a new QualityCheckStage object
+     *
+     * @param client  Client of "/ariac/perform_quality_check", whose callback group must not be
+     * blocked by the thread waiting for the verdicts
+     */
+    explicit QualityCheckStage(rclcpp::Client<ariac_msgs::srv::PerformQualityCheck>::SharedPtr client);
+
+    /**
+     * @brief Send the quality check of a kit, without blocking
+     *
+     * A previous verdict of the same order is forgotten.
+     * @param order_id  Order of the kit
+     * @param task  Kitting task of the order, to know which part is on which quadrant
+     */
+    void start(const std::string &order_id, const ariac_msgs::msg::KittingTask &task);
+
+    /**
+     * @brief Block until the verdict of the last check of an order is known
+     *
+     * @param order_id  Order of the kit
+     * @param timeout  Timeout in seconds
+     * @param all_passed  Verdict of the check, unchanged unless READY is returned
+     * @return WaitResult READY if the verdict is known, TIMEOUT otherwise (also for an order never checked)
+     */
+    WaitResult wait(const std::string &order_id, double timeout, bool &all_passed) const;
+
+    /**
+     * @brief Take the removal tasks of an order queued by its checks
+     */
+    std::vector<FaultyPart> take_faulty(const std::string &order_id);
+
+private:
+    //! Handle the response of a check, called by the executor
+    void done_(uint64_t check, const std::string &order_id, int agv_num,
+               const std::map<int, ariac_msgs::msg::Part> &parts,
+               rclcpp::Client<ariac_msgs::srv::PerformQualityCheck>::SharedFuture future);
+
+    //! Verdict of the last check of an order
+    struct Verdict
+    {
+        //! Number of the check, responses of earlier checks are ignored
+        uint64_t check{0};
+        bool done{false};
+        bool all_passed{false};
+    };
+
+    rclcpp::Client<ariac_msgs::srv::PerformQualityCheck>::SharedPtr client_;
+    std::map<std::string, Verdict> verdicts_;
+    uint64_t checks_{0};
+    std::vector<FaultyPart> faulty_;
+    mutable std::mutex mutex_;
+    mutable std::condition_variable changed_;
+};
@@ -0,0 +1,143 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+
+#include <geometry_msgs/msg/pose.hpp>
+
+#include "mesh_registry.hpp"
+#include "planning_scene_builder.hpp"
+
+/**
+ * @brief Lifecycle state of a dynamic object of the planning scene
+ */
+enum class SceneObjectState
+{
+    //! Added to the world, not touched yet
+    ADDED,
+    //! Attached to the gripper
+    ATTACHED,
+    //! Released somewhere in the cell
+    DETACHED,
+    //! Removed from the scene, or unknown
+    REMOVED
+};
+
+/**
+ * @brief Tracks the trays and parts the floor robot adds to the planning scene
+ *
+ * Every physical object gets its own id, made of its kind (e.g. "kit_tray_3" or
+ * "purple_battery") and a sequence number, so two trays with the same tray id or
+ * two parts of the same type and color never alias each other. Objects go through
+ * the added -> attached -> detached -> removed states. Additions and removals are
+ * staged in a PlanningSceneBuilder, so that the caller flushes only what changed.
+ *
+ * A detached object is labelled with the location it was released at, an area
+ * optionally followed by "/" and a slot (e.g. "agv2" for a tray, "agv2/3" for a part
+ * in quadrant 3). Objects of an area that left the cell are removed with collect().
+ */
+class SceneObjectManager
+{
+public:
+    /**
+     * @brief Construct a new Scene Object Manager object
+     *
+     * @param mesh_registry Meshes of the objects, must outlive the manager
+     */
+    explicit SceneObjectManager(const MeshRegistry &mesh_registry);
+
+    /**
+     * @brief Stage the addition of a new object
+     *
+     * @param builder  Batch of changes
+     * @param kind  Kind of the object, prefix of its id
+     * @param mesh_file  Mesh file of the object
+     * @param pose  Pose of the object in the world frame
+     * @return std::string Unique id of the object, empty if the mesh is unknown
+     */
+    std::string add(PlanningSceneBuilder &builder, const std::string &kind, const std::string &mesh_file,
+                    const geometry_msgs::msg::Pose &pose);
+
+    /**
+     * @brief Record that an object was attached to the gripper
+     *
+     * @return true if the object is known
+     * @return false otherwise
+     */
+    bool attach(const std::string &id);
+
+    /**
+     * @brief Record that an object was released
+     *
+     * @param id  Id of the object
+     * @param location  Where the object was released, "area" or "area/slot"
+     * @return true if the object was attached
+     * @return false otherwise
+     */
+    bool detach(const std::string &id, const std::string &location);
+
+    /**
+     * @brief Find a detached object of a kind at a location
+     *
+     * @return std::string Id of the object, empty if there is none
+     */
+    std::string find(const std::string &kind, const std::string &location) const;
+
+    /**
+     * @brief Stage the removal of an object
+     *
+     * @return true if the object was in the scene and not attached
+     * @return false otherwise
+     */
+    bool remove(PlanningSceneBuilder &builder, const std::string &id);
+
+    /**
+     * @brief Stage the removal of all the objects detached in an area
+     *
+     * @param builder  Batch of changes
+     * @param area  Area that left the cell, matches the locations "area" and "area/<slot>"
+     * @return std::size_t Number of objects removed
+     */
+    std::size_t collect(PlanningSceneBuilder &builder, const std::string &area);
+
+    /**
+     * @brief Get the state of an object
+     */
+    SceneObjectState state(const std::string &id) const;
+
+    /**
+     * @brief Number of objects currently in the scene
+     */
+    std::size_t live_count() const;
+
+    /**
+     * @brief Describe the live objects and the counters
+     */
+    std::string report() const;
+
+private:
+    //! Dynamic object of the scene
+    struct SceneObject
+    {
+        std::string kind;
+        SceneObjectState state{SceneObjectState::ADDED};
+        //! Location of a detached object
+        std::string location;
+    };
+
+    //! Remove an object, the caller holds the lock
+    void remove_(PlanningSceneBuilder &builder, std::map<std::string, SceneObject>::iterator it);
+
+    const MeshRegistry &mesh_registry_;
+    //! Live objects by id
+    std::map<std::string, SceneObject> objects_;
+    //! Last sequence number of each kind
+    std::map<std::string, uint64_t> sequence_;
+    //! Objects added since startup
+    uint64_t added_{0};
+    //! Objects removed since startup
+    uint64_t removed_{0};
+    mutable std::mutex mutex_;
+};
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "agv_locations.hpp"
+
+/**
+ * @brief Orders on their way to the warehouse, submitted when their AGV gets there
+ *
+ * Each tracked order is watched by its own worker thread, which waits for the AGV
+ * to reach the warehouse, submits the order and reports the outcome. The order thread
+ * hands the order over and starts the next one at once, so the robot works while the
+ * AGVs travel. There is at most one shipment per AGV at a time.
+ */
+class ShippingTracker
+{
+public:
+    //! Submit an order, true if it was accepted
+    using SubmitFunction = std::function<bool(const std::string &order_id)>;
+    //! Report the outcome of a shipment
+    using ReportFunction = std::function<void(const std::string &order_id, int agv_num, bool submitted)>;
+
+    /**
+     * @brief Construct a new ShippingTracker object
+     *
+     * @param agv_locations  Locations of the AGVs, cancelled when the tracker is
+     * @param submit  Called from the worker threads to submit an order
+     * @param report  Called from the worker threads once an order was submitted or given up
+     */
+    ShippingTracker(AgvLocations &agv_locations, SubmitFunction submit, ReportFunction report);
+
+    /**
+     * @brief Cancel the shipments still waiting and join the worker threads
+     */
+    ~ShippingTracker();
+
+    /**
+     * @brief Submit an order once its AGV reaches the warehouse, without blocking
+     *
+     * @param order_id  Id of the order
+     * @param agv_num  Number of the AGV carrying the order
+     * @param timeout  Timeout in seconds for the AGV to reach the warehouse
+     */
+    void track(const std::string &order_id, int agv_num, double timeout);
+
+    /**
+     * @brief Block until no shipment is in progress on an AGV
+     *
+     * @param agv_num  Number of the AGV
+     * @param timeout  Timeout in seconds
+     * @return true  The AGV is not shipping anything
+     * @return false The timeout expired first
+     */
+    bool wait_shipped(int agv_num, double timeout) const;
+
+    /**
+     * @brief Block until no shipment is in progress
+     *
+     * @param timeout  Timeout in seconds
+     * @return true  All the shipments are over
+     * @return false The timeout expired first
+     */
+    bool wait_all(double timeout) const;
+
+    /**
+     * @brief Get the number of shipments in progress
+     */
+    std::size_t pending() const;
+
+    /**
+     * @brief Cancel the shipments still waiting for their AGV and join the worker threads
+     */
+    void cancel();
+
+private:
+    //! Body of the worker thread of a shipment
+    void ship_(std::string order_id, int agv_num, double timeout);
+    //! Join the workers whose shipment is over, called with mutex_ held
+    void reap_finished_();
+
+    AgvLocations &agv_locations_;
+    SubmitFunction submit_;
+    ReportFunction report_;
+    //! AGVs with a shipment in progress
+    std::vector<int> shipping_;
+    std::vector<std::thread> workers_;
+    //! Workers whose shipment is over, joined by the next call to track()
+    std::vector<std::thread::id> finished_;
+    mutable std::mutex mutex_;
+    mutable std::condition_variable changed_;
+};
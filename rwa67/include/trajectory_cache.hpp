@@ -0,0 +1,134 @@
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <geometry_msgs/msg/pose.hpp>
+#include <moveit_msgs/msg/robot_trajectory.hpp>
+
+/**
+ * @brief Cache of time-parameterized Cartesian trajectories
+ *
+ * Bins, AGV trays and approach heights repeat across orders, so the floor robot
+ * keeps asking for the same Cartesian path from (almost) the same start state.
+ * Entries are keyed by a quantized start joint state, a quantized waypoint list and
+ * the velocity/acceleration scaling factors. The least recently used entry is
+ * evicted once the cache is full.
+ */
+class TrajectoryCache
+{
+public:
+    //! Counters reported by the cache
+    struct Stats
+    {
+        //! Number of lookups that returned a stored trajectory
+        uint64_t hits{0};
+        //! Number of lookups that required planning
+        uint64_t misses{0};
+        //! Number of stored trajectories rejected because they were no longer valid
+        uint64_t rejected{0};
+        //! Planning time (in seconds) avoided by replaying stored trajectories
+        double saved_planning_time{0.0};
+    };
+
+    /**
+     * @brief Construct a new TrajectoryCache object
+     *
+     * @param capacity Maximum number of stored trajectories
+     * @param joint_resolution Quantization step for joint values (rad or m)
+     * @param position_resolution Quantization step for waypoint positions (m)
+     * @param orientation_resolution Quantization step for waypoint quaternion components
+     * @param scaling_resolution Quantization step for the scaling factors
+     */
+    TrajectoryCache(std::size_t capacity = 256,
+                    double joint_resolution = 1e-3,
+                    double position_resolution = 1e-3,
+                    double orientation_resolution = 1e-3,
+                    double scaling_resolution = 1e-2);
+
+    /**
+     * @brief Build the key of a Cartesian motion request
+     *
+     * The key is written into an existing string to reuse its capacity.
+     * @param start_joints Joint values of the floor robot at the start of the motion
+     * @param waypoints  Waypoints to move through
+     * @param vsf  Velocity scale factor
+     * @param asf  Acceleration scale factor
+     * @param key  Key of the request
+     */
+    void make_key(const std::vector<double> &start_joints,
+                  const std::vector<geometry_msgs::msg::Pose> &waypoints,
+                  double vsf, double asf, std::string &key) const;
+
+    /**
+     * @brief Look up a stored trajectory
+     *
+     * @param key Key built with TrajectoryCache::make_key
+     * @param trajectory Stored trajectory, only set on a hit
+     * @return true A trajectory is stored for this key
+     * @return false No trajectory is stored for this key
+     */
+    bool lookup(const std::string &key, moveit_msgs::msg::RobotTrajectory &trajectory);
+
+    /**
+     * @brief Store a trajectory
+     *
+     * @param key Key built with TrajectoryCache::make_key
+     * @param trajectory Time-parameterized trajectory
+     * @param planning_time Time (in seconds) it took to plan the trajectory
+     */
+    void insert(const std::string &key, const moveit_msgs::msg::RobotTrajectory &trajectory, double planning_time);
+
+    /**
+     * @brief Drop a trajectory returned by TrajectoryCache::lookup that turned out to be invalid
+     *
+     * The lookup is then accounted as a miss.
+     * @param key Key of the rejected trajectory
+     */
+    void reject(const std::string &key);
+
+    /**
+     * @brief Remove all stored trajectories (counters are kept)
+     *
+     * Called when the static geometry of the planning scene changes.
+     */
+    void clear();
+
+    /**
+     * @brief Get the counters of the cache
+     */
+    Stats stats() const;
+
+    /**
+     * @brief Get the number of stored trajectories
+     */
+    std::size_t size() const;
+
+private:
+    //! Stored trajectory along with its planning cost
+    struct Entry
+    {
+        moveit_msgs::msg::RobotTrajectory trajectory;
+        double planning_time;
+        std::list<std::string>::iterator lru_it;
+    };
+
+    //! Append a quantized value to a key
+    static void append_quantized_(std::string &key, double value, double resolution);
+
+    std::size_t capacity_;
+    double joint_resolution_;
+    double position_resolution_;
+    double orientation_resolution_;
+    double scaling_resolution_;
+
+    //! Keys ordered from most to least recently used
+    std::list<std::string> lru_;
+    std::unordered_map<std::string, Entry> entries_;
+    Stats stats_;
+    mutable std::mutex mutex_;
+};
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <Eigen/Geometry>
+#include <geometry_msgs/msg/pose.hpp>
+#include <moveit/robot_state/robot_state.h>
+
+/**
+ * @brief Joint-space path generator for vertical approach and retreat moves
+ *
+ * Most Cartesian motions of the floor robot move the gripper straight up or down at a
+ * fixed orientation. Instead of one IK call per centimeter, the generator solves IK at
+ * the ends of each vertical segment, seeded from the previous solution, and fills the
+ * samples in between by joint interpolation. A span is bisected (with a new IK call at
+ * its middle) whenever the Jacobian at one of its ends is poorly conditioned or one of
+ * the interpolated samples strays from the vertical line.
+ *
+ * Joint values are stored in the variable order of the planning group.
+ */
+class VerticalMoveGenerator
+{
+public:
+    //! Path produced for a list of waypoints
+    struct Result
+    {
+        //! Joint values of every sample, starting with the start state
+        std::vector<std::vector<double>> path;
+        //! Number of IK calls made
+        std::size_t ik_calls{0};
+        //! Number of samples obtained by joint interpolation
+        std::size_t interpolated_samples{0};
+    };
+
+    /**
+     * @brief Construct a new VerticalMoveGenerator object
+     *
+     * @param group Planning group of the robot
+     * @param tip_link Link that follows the waypoints
+     * @param eef_step Distance (in m) between two consecutive samples
+     * @param position_tolerance Maximum distance (in m) between a sample and the vertical line
+     * @param orientation_tolerance Maximum angle (in rad) between the orientation of a sample and the waypoint orientation
+     * @param min_conditioning Smallest ratio between the lowest and highest singular values of the Jacobian for joint interpolation
+     * @param max_joint_step Largest change (in rad or m) of a joint between two consecutive samples
+     * @param ik_timeout Timeout (in s) of each IK call
+     */
+    VerticalMoveGenerator(const moveit::core::JointModelGroup *group,
+                          const std::string &tip_link,
+                          double eef_step = 0.01,
+                          double position_tolerance = 0.001,
+                          double orientation_tolerance = 0.01,
+                          double min_conditioning = 0.05,
+                          double max_joint_step = 0.1,
+                          double ik_timeout = 0.005);
+
+    /**
+     * @brief Check whether all the waypoints are straight above or below the tip link, at its current orientation
+     *
+     * @param start_state State of the robot at the start of the motion
+     * @param waypoints Waypoints to move through
+     * @return true The motion is a vertical move
+     * @return false The motion has a horizontal or rotational component
+     */
+    bool is_vertical(const moveit::core::RobotState &start_state,
+                     const std::vector<geometry_msgs::msg::Pose> &waypoints) const;
+
+    /**
+     * @brief Generate the joint path of a vertical move
+     *
+     * Collisions are not checked.
+     * @param start_state State of the robot at the start of the motion
+     * @param waypoints Waypoints to move through
+     * @param result Generated path, only complete on success
+     * @return true The path follows the waypoints within tolerance
+     * @return false The motion is not vertical, an IK call failed or the path jumps
+     */
+    bool generate(const moveit::core::RobotState &start_state,
+                  const std::vector<geometry_msgs::msg::Pose> &waypoints,
+                  Result &result) const;
+
+private:
+    //! Convert a pose message to an isometry
+    static Eigen::Isometry3d to_isometry_(const geometry_msgs::msg::Pose &pose);
+
+    //! Whether two poses are within the position and orientation tolerances
+    bool is_close_(const Eigen::Isometry3d &pose1, const Eigen::Isometry3d &pose2) const;
+
+    //! Whether the Jacobian of the group is well-conditioned for the joint values
+    bool is_well_conditioned_(moveit::core::RobotState &state, const std::vector<double> &joint_values) const;
+
+    //! Pose of the tip link for the joint values
+    Eigen::Isometry3d forward_kinematics_(moveit::core::RobotState &state, const std::vector<double> &joint_values) const;
+
+    //! Solve IK for a pose, seeded with the given joint values
+    bool solve_ik_(moveit::core::RobotState &state, const Eigen::Isometry3d &pose,
+                   const std::vector<double> &seed, std::vector<double> &joint_values, Result &result) const;
+
+    //! Fill the samples strictly between lo and hi, which are already solved
+    bool fill_span_(moveit::core::RobotState &state, const std::vector<Eigen::Isometry3d> &samples,
+                    std::vector<std::vector<double>> &solutions, std::size_t lo, std::size_t hi, Result &result) const;
+
+    const moveit::core::JointModelGroup *group_;
+    std::string tip_link_;
+    double eef_step_;
+    double position_tolerance_;
+    double orientation_tolerance_;
+    double min_conditioning_;
+    double max_joint_step_;
+    double ik_timeout_;
+};
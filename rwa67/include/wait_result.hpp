@@ -0,0 +1,16 @@
+#pragma once
+
+/**
+ * @brief Outcome of a blocking wait on a state shared with the subscription callbacks
+ */
+enum class WaitResult
+{
+    //! The awaited state was reached
+    READY,
+    //! The deadline expired first
+    TIMEOUT,
+    //! Nothing more will come, the awaited state cannot be reached anymore
+    DRAINED,
+    //! The wait was cancelled, e.g. because the competition ended
+    CANCELLED
+};
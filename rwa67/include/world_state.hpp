@@ -0,0 +1,176 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <geometry_msgs/msg/pose.hpp>
+#include <ariac_msgs/msg/advanced_logical_camera_image.hpp>
+#include <ariac_msgs/msg/kit_tray_pose.hpp>
+#include <ariac_msgs/msg/part_pose.hpp>
+
+#include "part_inventory.hpp"
+
+/**
+ * @brief Cameras feeding the world state of the floor robot
+ */
+enum class WorldCamera
+{
+    KTS1,
+    KTS2,
+    LEFT_BINS,
+    RIGHT_BINS
+};
+
+/**
+ * @brief Latest frame of a camera
+ *
+ * The frame holds the message of the camera itself: the parts and trays are views
+ * over the message, not copies of it.
+ */
+struct CameraView
+{
+    //! World sequence number of the frame, 0 if the camera has not published yet
+    uint64_t sequence{0};
+    //! Time the frame was published
+    std::chrono::steady_clock::time_point stamp;
+    //! Message of the camera, null if the camera has not published yet
+    ariac_msgs::msg::AdvancedLogicalCameraImage::ConstSharedPtr image;
+    //! Parts seen by the camera, in the world frame, indexed by (type, color)
+    PartInventory inventory;
+
+    /**
+     * @brief Pose of the camera in the world frame
+     */
+    const geometry_msgs::msg::Pose &sensor_pose() const;
+
+    /**
+     * @brief Parts seen by the camera, in the camera frame
+     */
+    const std::vector<ariac_msgs::msg::PartPose> &parts() const;
+
+    /**
+     * @brief Trays seen by the camera, in the camera frame
+     */
+    const std::vector<ariac_msgs::msg::KitTrayPose> &trays() const;
+};
+
+/**
+ * @brief Bytes moved by the camera frames since the first one
+ */
+struct WorldStateStats
+{
+    //! Number of frames published
+    uint64_t frames{0};
+    //! Bytes of the messages kept by reference, which used to be copied into the frames
+    uint64_t bytes_shared{0};
+    //! Bytes written into the frames (the world poses of the parts)
+    uint64_t bytes_copied{0};
+    //! Time from the first frame to the last one, in seconds
+    double seconds{0.0};
+};
+
+//! Immutable camera frame
+using CameraViewConstPtr = std::shared_ptr<const CameraView>;
+
+/**
+ * @brief Latest frames of all the cameras, taken at once
+ */
+struct WorldSnapshot
+{
+    //! Number of cameras
+    static constexpr std::size_t CAMERA_COUNT = 4;
+
+    //! Latest frame of each camera
+    std::array<CameraViewConstPtr, CAMERA_COUNT> cameras;
+    //! Highest sequence number of the frames
+    uint64_t sequence{0};
+
+    /**
+     * @brief Latest frame of a camera
+     */
+    const CameraView &camera(WorldCamera camera) const { return *cameras[static_cast<std::size_t>(camera)]; }
+
+    /**
+     * @brief Find the bin part of a type and color nearest to a position of the rail
+     *
+     * @param type  Type of the part
+     * @param color  Color of the part
+     * @param rail_position  Position of the linear actuator
+     * @param pose  World pose of the part, unchanged if there is none
+     * @param camera  Camera that saw the part (LEFT_BINS or RIGHT_BINS), unchanged if there is none
+     * @return true if a part was found
+     * @return false otherwise
+     */
+    bool nearest_bin_part(uint8_t type, uint8_t color, double rail_position,
+                          geometry_msgs::msg::Pose &pose, WorldCamera &camera) const;
+};
+
+/**
+ * @brief What the cameras see, published by the camera callbacks and read by the service handlers
+ *
+ * Each camera has a front frame, read by any thread, and a back frame, written by the
+ * camera callback. Publishing fills the back frame and swaps it with the front one
+ * atomically, so readers never block the callbacks nor see a frame being written.
+ * Frames keep the shared messages of the cameras instead of copying them. The back
+ * frame is reused, without reallocating its inventory, as soon as no reader holds it
+ * anymore. The world poses of the parts are computed once, when the frame
+ * is published. Every frame gets a sequence number, increasing across cameras,
+ * so readers can tell how fresh their data is.
+ *
+ * There must be at most one thread publishing the frames of a given camera at a time.
+ */
+class WorldState
+{
+public:
+    /**
+     * @brief Construct a new WorldState object, with an empty frame for each camera
+     */
+    WorldState();
+
+    /**
+     * @brief Publish a new frame of a camera
+     *
+     * The message is kept as is, not copied, for as long as the frame lives.
+     * @param camera  Camera of the frame
+     * @param image  Message of the camera
+     * @return uint64_t Sequence number of the frame
+     */
+    uint64_t publish(WorldCamera camera, ariac_msgs::msg::AdvancedLogicalCameraImage::ConstSharedPtr image);
+
+    /**
+     * @brief Get the latest frame of a camera
+     */
+    CameraViewConstPtr camera(WorldCamera camera) const;
+
+    /**
+     * @brief Get the latest frames of all the cameras
+     */
+    WorldSnapshot snapshot() const;
+
+    /**
+     * @brief Get the sequence number of the latest frame
+     */
+    uint64_t sequence() const;
+
+    /**
+     * @brief Get the bytes moved by the frames published so far
+     */
+    WorldStateStats stats() const;
+
+private:
+    //! Frames readers get, accessed with std::atomic_load/std::atomic_exchange
+    std::array<CameraViewConstPtr, WorldSnapshot::CAMERA_COUNT> front_;
+    //! Frames being written, only touched by the publishing thread of each camera
+    std::array<std::shared_ptr<CameraView>, WorldSnapshot::CAMERA_COUNT> back_;
+    std::atomic<uint64_t> sequence_{0};
+    std::atomic<uint64_t> bytes_shared_{0};
+    std::atomic<uint64_t> bytes_copied_{0};
+    //! Time of the first frame, in steady clock nanoseconds, 0 before it
+    std::atomic<int64_t> first_stamp_{0};
+    //! Time of the latest frame, in steady clock nanoseconds
+    std::atomic<int64_t> last_stamp_{0};
+};
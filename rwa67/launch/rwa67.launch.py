@@ -70,6 +70,12 @@ def generate_launch_description():
         executable="change_gripper_server",
         parameters=[{"emulate_only":False}]
     )
+    # camera diff node, publishes the inventory changes seen by the cameras
+    camera_diff = Node(
+        package="rwa67",
+        executable="camera_diff",
+        parameters=[{"match_distance":0.1, "move_tolerance":0.005}]
+    )
     # pickup tray server
     pickup_tray_server = Node(
         package="rwa67",
@@ -81,11 +87,13 @@ def generate_launch_description():
         executable="start_pickup_part_server.py",
     )
     # floor robot server
+    floor_robot_parameters = generate_parameters()
+    floor_robot_parameters.append(PathJoinSubstitution([FindPackageShare("rwa67"), "config", "motion_profiles.yaml"]))
     floor_robot_server = Node(
         package='rwa67',
         executable='floor_robot_server',
         # output="screen",
-        parameters=generate_parameters()
+        parameters=floor_robot_parameters
     )
     # moveit node
     moveit = IncludeLaunchDescription(
@@ -101,6 +109,7 @@ def generate_launch_description():
     ld.add_action(submit_orders_agv3)
     ld.add_action(submit_orders_agv4)
     ld.add_action(change_gripper_server)
+    ld.add_action(camera_diff)
     # ld.add_action(moveit)
     ld.add_action(floor_robot_server)
     
@@ -34,6 +34,11 @@ from ariac_msgs.srv import (
     PerformQualityCheck
 )
 
+from custom_msgs.msg import (
+    InventoryDelta,
+    InventoryItem
+)
+
 from custom_msgs.srv import (
     ChangeGripper as CustomChangeGripper,
     PickupPart,
@@ -192,6 +197,18 @@ class CompetitionInterface(Node):
             callback_group=cam_callbackgrp)
         
         self._cam_updated = dict()
+
+        # Subscriber to the inventory changes published by the camera diff node,
+        # keeps the parts and trays current after the first image of each camera
+        self.inventory_delta_sub = self.create_subscription(
+            InventoryDelta,
+            '/rwa67/inventory_delta',
+            self._inventory_delta_cb,
+            100,
+            callback_group=cam_callbackgrp)
+
+        # Stored Part/Tray objects by inventory id of the camera diff node
+        self._inventory_items = dict()
         
         # Store each camera image as an AdvancedLogicalCameraImage object
         self._camera_image: AdvancedLogicalCameraImage = None
@@ -469,6 +486,59 @@ class CompetitionInterface(Node):
         self.find_part_tray(self._camera_image,"kitting station 2 camera")
         self._cam_updated["kts2"]=True
     
+    def _inventory_delta_cb(self, msg: InventoryDelta):
+        '''
+        Apply the changes seen by a camera to the stored parts and trays
+
+        Arguments:
+            msg -- InventoryDelta message, poses in the world frame
+        '''
+        for item in msg.added:
+            item: InventoryItem
+            if self._check_for_new_parts is False:
+                break
+            stored = self._find_stored_item(item)
+            if stored is None:
+                if item.kind == InventoryItem.PART:
+                    self._part_count += 1
+                    stored = Part(part_msg=PartPoseMsg(part=PartMsg(type=item.type, color=item.color), pose=item.pose),
+                                  part_id=self._part_count)
+                    self._parts.append(stored)
+                else:
+                    stored = Tray(tray_msg=KitTrayPose(id=item.tray_id, pose=item.pose))
+                    self._trays.append(stored)
+            self._inventory_items[item.id] = stored
+
+        for item in msg.moved:
+            stored = self._inventory_items.get(item.id)
+            if stored is not None:
+                stored.pose = item.pose
+
+        # objects assigned to an order are left to the action tree
+        for item in msg.removed:
+            stored = self._inventory_items.pop(item.id, None)
+            if stored is None or stored.assigned_order != "":
+                continue
+            if stored in self._parts:
+                self._parts.remove(stored)
+            elif stored in self._trays:
+                self._trays.remove(stored)
+
+    def _find_stored_item(self, item: InventoryItem):
+        '''
+        Find the stored part or tray matching an inventory item, None if there is none
+        '''
+        if item.kind == InventoryItem.PART:
+            for stored_part in self._parts:
+                if stored_part.color == item.color and stored_part.type == item.type and \
+                    dist_two_poses(stored_part.pose, item.pose) < 0.1:
+                    return stored_part
+        else:
+            for stored_tray in self._trays:
+                if stored_tray.id == item.tray_id and dist_two_poses(stored_tray.pose, item.pose) < 0.1:
+                    return stored_tray
+        return None
+
     def find_part_tray(self, image: AdvancedLogicalCameraImage, camera_name="cam"):
         """find the trays and parts from the advanced logical camera image
 
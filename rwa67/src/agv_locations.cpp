@@ -0,0 +1,64 @@
+#include "agv_locations.hpp"
+
+#include <chrono>
+
+//=============================================//
+AgvLocations::AgvLocations(int count)
+    : locations_(count, -1)
+{
+}
+
+//=============================================//
+int AgvLocations::set(int agv_num, int location)
+{
+    if (agv_num < 1 || agv_num > static_cast<int>(locations_.size()))
+        return -1;
+
+    int previous;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        previous = locations_[agv_num - 1];
+        locations_[agv_num - 1] = location;
+    }
+    if (previous != location)
+        changed_.notify_all();
+
+    return previous;
+}
+
+//=============================================//
+int AgvLocations::get(int agv_num) const
+{
+    if (agv_num < 1 || agv_num > static_cast<int>(locations_.size()))
+        return -1;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    return locations_[agv_num - 1];
+}
+
+//=============================================//
+WaitResult AgvLocations::wait_for(int agv_num, int location, double timeout) const
+{
+    if (agv_num < 1 || agv_num > static_cast<int>(locations_.size()))
+        return WaitResult::TIMEOUT;
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    bool reached = changed_.wait_for(lock, std::chrono::duration<double>(timeout),
+                                     [this, agv_num, location]()
+                                     { return cancelled_ || locations_[agv_num - 1] == location; });
+
+    if (cancelled_)
+        return WaitResult::CANCELLED;
+
+    return reached ? WaitResult::READY : WaitResult::TIMEOUT;
+}
+
+//=============================================//
+void AgvLocations::cancel()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        cancelled_ = true;
+    }
+    changed_.notify_all();
+}
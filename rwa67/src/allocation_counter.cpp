@@ -0,0 +1,46 @@
+#include "allocation_counter.hpp"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace
+{
+    // plain data, no dynamic initialization needed before the first allocation of a thread
+    thread_local uint64_t thread_count = 0;
+    std::atomic<uint64_t> total_count{0};
+} // namespace
+
+//=============================================//
+uint64_t allocation_counter::thread_allocations()
+{
+    return thread_count;
+}
+
+//=============================================//
+uint64_t allocation_counter::total_allocations()
+{
+    return total_count.load(std::memory_order_relaxed);
+}
+
+// The other forms of operator new (array, nothrow) forward to this one
+void *operator new(std::size_t size)
+{
+    thread_count++;
+    total_count.fetch_add(1, std::memory_order_relaxed);
+
+    if (void *pointer = std::malloc(size == 0 ? 1 : size))
+        return pointer;
+
+    throw std::bad_alloc();
+}
+
+void operator delete(void *pointer) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete(void *pointer, std::size_t) noexcept
+{
+    std::free(pointer);
+}
@@ -0,0 +1,289 @@
+#include "batch_planner.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <sstream>
+
+namespace
+{
+    //! Cost of placing a part before the tray of its kit
+    constexpr double INFEASIBLE = 1e9;
+} // namespace
+
+//=============================================//
+RailCostModel::RailCostModel(double seconds_per_move, double seconds_per_meter, double seconds_per_gripper_change)
+    : seconds_per_move_(seconds_per_move),
+      seconds_per_meter_(seconds_per_meter),
+      seconds_per_gripper_change_(seconds_per_gripper_change)
+{
+}
+
+//=============================================//
+double RailCostModel::travel(double from, double to) const
+{
+    double distance = std::abs(to - from);
+    if (distance < 1e-3)
+        return 0.0;
+
+    return seconds_per_move_ + seconds_per_meter_ * distance;
+}
+
+//=============================================//
+double RailCostModel::gripper_change() const
+{
+    return seconds_per_gripper_change_;
+}
+
+//=============================================//
+void RailCostModel::record(double distance, double seconds)
+{
+    n_++;
+    sum_d_ += distance;
+    sum_t_ += seconds;
+    sum_dd_ += distance * distance;
+    sum_dt_ += distance * seconds;
+    fit_();
+}
+
+//=============================================//
+void RailCostModel::fit_()
+{
+    // the priors are kept until the moves are long and short enough to separate both terms
+    if (n_ < 5)
+        return;
+
+    double n = static_cast<double>(n_);
+    double variance = sum_dd_ / n - (sum_d_ / n) * (sum_d_ / n);
+    if (variance < 0.25)
+        return;
+
+    double slope = (sum_dt_ / n - (sum_d_ / n) * (sum_t_ / n)) / variance;
+    double intercept = sum_t_ / n - slope * sum_d_ / n;
+    if (slope <= 0.0 || intercept < 0.0)
+        return;
+
+    seconds_per_meter_ = slope;
+    seconds_per_move_ = intercept;
+}
+
+//=============================================//
+uint64_t RailCostModel::samples() const
+{
+    return n_;
+}
+
+//=============================================//
+std::string RailCostModel::report() const
+{
+    std::stringstream report;
+    report << seconds_per_move_ << " s + " << seconds_per_meter_ << " s/m (" << n_ << " moves), gripper change "
+           << seconds_per_gripper_change_ << " s";
+    return report.str();
+}
+
+//=============================================//
+BatchPlanner::BatchPlanner(const RailCostModel &cost, double kts1_position, double kts2_position, bool tray_first)
+    : cost_(cost), kts1_position_(kts1_position), kts2_position_(kts2_position), tray_first_(tray_first)
+{
+}
+
+//=============================================//
+std::vector<BatchStep> BatchPlanner::assign_(const std::vector<BatchJob> &jobs, const WorldSnapshot &world) const
+{
+    std::vector<BatchStep> steps;
+    steps.reserve(jobs.size());
+
+    // parts already chosen, from the inventories of the snapshot, as several parts of a bin row share a rail position
+    std::vector<const geometry_msgs::msg::Pose *> taken;
+    for (auto const &job : jobs)
+    {
+        BatchStep step{job, job.place_position, false};
+        if (job.is_tray())
+        {
+            for (auto station : {WorldCamera::KTS1, WorldCamera::KTS2})
+            {
+                auto const &trays = world.camera(station).trays();
+                if (std::any_of(trays.begin(), trays.end(), [&job](const ariac_msgs::msg::KitTrayPose &tray)
+                                { return tray.id == job.tray_id; }))
+                {
+                    step.pick_position = station == WorldCamera::KTS1 ? kts1_position_ : kts2_position_;
+                    step.located = true;
+                    break;
+                }
+            }
+            steps.push_back(step);
+            continue;
+        }
+
+        // the rail position of a part is -y
+        double best = std::numeric_limits<double>::max();
+        const geometry_msgs::msg::Pose *chosen = nullptr;
+        for (auto bins : {WorldCamera::LEFT_BINS, WorldCamera::RIGHT_BINS})
+        {
+            for (auto const &pose : world.camera(bins).inventory.parts(job.part.type, job.part.color))
+            {
+                if (std::find(taken.begin(), taken.end(), &pose) != taken.end())
+                    continue;
+
+                double position = -pose.position.y;
+                double distance = std::abs(position - job.place_position);
+                if (distance < best)
+                {
+                    best = distance;
+                    chosen = &pose;
+                    step.pick_position = position;
+                    step.located = true;
+                }
+            }
+        }
+        if (chosen)
+            taken.push_back(chosen);
+        steps.push_back(step);
+    }
+
+    return steps;
+}
+
+//=============================================//
+double BatchPlanner::cost(const std::vector<BatchStep> &steps, double rail_position, const std::string &gripper) const
+{
+    // orders whose tray is still to be placed
+    std::vector<const std::string *> trays_pending;
+    for (auto const &step : steps)
+    {
+        if (step.job.is_tray())
+            trays_pending.push_back(&step.job.order_id);
+    }
+
+    double seconds = 0.0;
+    auto current_gripper = &gripper;
+    for (auto const &step : steps)
+    {
+        auto tray = std::find_if(trays_pending.begin(), trays_pending.end(), [&step](const std::string *order_id)
+                                 { return *order_id == step.job.order_id; });
+        if (step.job.is_tray())
+            trays_pending.erase(tray);
+        else if (tray != trays_pending.end())
+            seconds += INFEASIBLE;
+
+        if (step.job.gripper != *current_gripper)
+        {
+            seconds += cost_.gripper_change();
+            current_gripper = &step.job.gripper;
+        }
+        seconds += cost_.travel(rail_position, step.pick_position);
+        seconds += cost_.travel(step.pick_position, step.job.place_position);
+        rail_position = step.job.place_position;
+    }
+
+    return seconds;
+}
+
+//=============================================//
+void BatchPlanner::sequence_(std::vector<BatchStep> &steps, double rail_position, const std::string &gripper) const
+{
+    // nearest neighbor tour
+    std::vector<BatchStep> tour;
+    tour.reserve(steps.size());
+    double position = rail_position;
+    auto current_gripper = gripper;
+    while (!steps.empty())
+    {
+        auto next = steps.begin();
+        double best = std::numeric_limits<double>::max();
+        for (auto step = steps.begin(); step != steps.end(); step++)
+        {
+            bool tray_pending = !step->job.is_tray() &&
+                                std::any_of(steps.begin(), steps.end(), [&step](const BatchStep &other)
+                                            { return other.job.is_tray() && other.job.order_id == step->job.order_id; });
+            if (tray_pending)
+                continue;
+
+            double seconds = cost_.travel(position, step->pick_position) +
+                             (step->job.gripper != current_gripper ? cost_.gripper_change() : 0.0);
+            if (seconds < best)
+            {
+                best = seconds;
+                next = step;
+            }
+        }
+        position = next->job.place_position;
+        current_gripper = next->job.gripper;
+        tour.push_back(*next);
+        steps.erase(next);
+    }
+
+    // move single jobs while it helps
+    double best = cost(tour, rail_position, gripper);
+    bool improved = true;
+    while (improved)
+    {
+        improved = false;
+        for (std::size_t from = 0; from < tour.size() && !improved; from++)
+        {
+            for (std::size_t to = 0; to < tour.size() && !improved; to++)
+            {
+                if (from == to)
+                    continue;
+
+                auto candidate = tour;
+                auto step = candidate[from];
+                candidate.erase(candidate.begin() + from);
+                candidate.insert(candidate.begin() + to, step);
+
+                double seconds = cost(candidate, rail_position, gripper);
+                if (seconds < best - 1e-6)
+                {
+                    tour.swap(candidate);
+                    best = seconds;
+                    improved = true;
+                }
+            }
+        }
+    }
+
+    steps.swap(tour);
+}
+
+//=============================================//
+std::vector<BatchStep> BatchPlanner::plan(const std::vector<BatchJob> &jobs, const WorldSnapshot &world,
+                                          double rail_position, const std::string &gripper, double &seconds) const
+{
+    auto steps = assign_(jobs, world);
+
+    // groups of jobs sequenced one after the other, priority jobs first
+    auto priority_end = std::stable_partition(steps.begin(), steps.end(),
+                                              [](const BatchStep &step)
+                                              { return step.job.priority; });
+    std::vector<std::vector<BatchStep>> groups;
+    if (tray_first_)
+    {
+        // a single tray session, then the parts
+        groups.resize(4);
+        for (auto step = steps.begin(); step != steps.end(); step++)
+            groups[(step->job.is_tray() ? 0 : 2) + (step < priority_end ? 0 : 1)].push_back(*step);
+    }
+    else
+    {
+        groups.emplace_back(steps.begin(), priority_end);
+        groups.emplace_back(priority_end, steps.end());
+    }
+
+    steps.clear();
+    double position = rail_position;
+    auto current_gripper = gripper;
+    for (auto &group : groups)
+    {
+        if (group.empty())
+            continue;
+
+        sequence_(group, position, current_gripper);
+        position = group.back().job.place_position;
+        current_gripper = group.back().job.gripper;
+        steps.insert(steps.end(), group.begin(), group.end());
+    }
+
+    seconds = cost(steps, rail_position, gripper);
+    return steps;
+}
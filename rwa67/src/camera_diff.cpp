@@ -0,0 +1,93 @@
+#include "camera_diff.hpp"
+
+#include <sstream>
+
+//=============================================//
+CameraDiff::CameraDiff() : Node("camera_diff")
+{
+    this->declare_parameter("match_distance", 0.1);
+    this->declare_parameter("move_tolerance", 0.005);
+    auto match_distance = this->get_parameter("match_distance").as_double();
+    auto move_tolerance = this->get_parameter("move_tolerance").as_double();
+
+    cbg_ = create_callback_group(rclcpp::CallbackGroupType::MutuallyExclusive);
+    rclcpp::SubscriptionOptions options;
+    options.callback_group = cbg_;
+
+    // deltas must not be lost, unlike the camera frames
+    delta_pub_ = this->create_publisher<custom_msgs::msg::InventoryDelta>(
+        "/rwa67/inventory_delta", rclcpp::QoS(100).reliable());
+
+    for (std::size_t camera = 0; camera < CAMERA_COUNT; camera++)
+    {
+        trackers_[camera] = std::make_unique<InventoryTracker>(next_id_, match_distance, move_tolerance);
+        deltas_[camera].header.frame_id = "world";
+        deltas_[camera].camera = camera_names_[camera];
+
+        camera_subs_[camera] = this->create_subscription<ariac_msgs::msg::AdvancedLogicalCameraImage>(
+            "/ariac/sensors/" + camera_names_[camera] + "/image", rclcpp::SensorDataQoS(),
+            [this, camera](const ariac_msgs::msg::AdvancedLogicalCameraImage::ConstSharedPtr msg)
+            { camera_cb_(camera, msg); },
+            options);
+    }
+
+    stats_srv_ = create_service<std_srvs::srv::Trigger>(
+        "/rwa67/camera_diff/stats",
+        std::bind(
+            &CameraDiff::stats_srv_cb_, this,
+            std::placeholders::_1, std::placeholders::_2),
+        rmw_qos_profile_services_default,
+        cbg_);
+}
+
+//=============================================//
+void CameraDiff::camera_cb_(std::size_t camera, const ariac_msgs::msg::AdvancedLogicalCameraImage::ConstSharedPtr msg)
+{
+    auto &stats = stats_[camera];
+    auto &delta = deltas_[camera];
+    stats.frames++;
+
+    if (!trackers_[camera]->update(*msg, delta))
+    {
+        stats.unchanged++;
+        return;
+    }
+
+    stats.deltas++;
+    delta.header.stamp = now();
+    delta.sequence = stats.deltas;
+    delta_pub_->publish(delta);
+
+    RCLCPP_DEBUG_STREAM(get_logger(), camera_names_[camera] << ": " << delta.added.size() << " added, "
+                                                            << delta.removed.size() << " removed, "
+                                                            << delta.moved.size() << " moved");
+}
+
+//=============================================//
+void CameraDiff::stats_srv_cb_(
+    std_srvs::srv::Trigger::Request::SharedPtr request,
+    std_srvs::srv::Trigger::Response::SharedPtr response)
+{
+    (void)request; // remove unused parameter warning
+
+    std::stringstream message;
+    for (std::size_t camera = 0; camera < CAMERA_COUNT; camera++)
+    {
+        auto const &stats = stats_[camera];
+        message << camera_names_[camera] << ": " << stats.frames << " frames, " << stats.unchanged
+                << " unchanged, " << stats.deltas << " deltas, " << trackers_[camera]->size() << " objects; ";
+    }
+
+    response->success = true;
+    response->message = message.str();
+}
+
+int main(int argc, char *argv[])
+{
+    rclcpp::init(argc, argv);
+    rclcpp::executors::MultiThreadedExecutor executor;
+    auto node = std::make_shared<CameraDiff>();
+    executor.add_node(node);
+    executor.spin();
+    rclcpp::shutdown();
+}
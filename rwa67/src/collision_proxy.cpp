@@ -0,0 +1,156 @@
+#include "collision_proxy.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    //! Occupancy grid over the bounding box of a mesh
+    struct VoxelGrid
+    {
+        double origin[3];
+        double resolution;
+        int size[3];
+        std::vector<bool> occupied;
+        std::vector<bool> used;
+
+        std::size_t index(int x, int y, int z) const
+        {
+            return (static_cast<std::size_t>(z) * size[1] + y) * size[0] + x;
+        }
+
+        bool free(int x, int y, int z) const
+        {
+            auto i = index(x, y, z);
+            return !occupied[i] || used[i];
+        }
+
+        void mark(double px, double py, double pz)
+        {
+            double p[3] = {px, py, pz};
+            int cell[3];
+            for (int axis = 0; axis < 3; axis++)
+                cell[axis] = std::clamp(static_cast<int>(std::floor((p[axis] - origin[axis]) / resolution)), 0, size[axis] - 1);
+            occupied[index(cell[0], cell[1], cell[2])] = true;
+        }
+    };
+
+    double distance(const geometry_msgs::msg::Point &a, const geometry_msgs::msg::Point &b)
+    {
+        return std::sqrt((a.x - b.x) * (a.x - b.x) + (a.y - b.y) * (a.y - b.y) + (a.z - b.z) * (a.z - b.z));
+    }
+} // namespace
+
+//=============================================//
+CollisionProxy make_box_proxy(const shape_msgs::msg::Mesh &mesh, double resolution)
+{
+    CollisionProxy proxy;
+    if (mesh.vertices.empty() || mesh.triangles.empty() || resolution <= 0.0)
+        return proxy;
+
+    // bounding box of the mesh
+    double min[3] = {mesh.vertices[0].x, mesh.vertices[0].y, mesh.vertices[0].z};
+    double max[3] = {min[0], min[1], min[2]};
+    for (auto const &vertex : mesh.vertices)
+    {
+        double p[3] = {vertex.x, vertex.y, vertex.z};
+        for (int axis = 0; axis < 3; axis++)
+        {
+            min[axis] = std::min(min[axis], p[axis]);
+            max[axis] = std::max(max[axis], p[axis]);
+        }
+    }
+
+    VoxelGrid grid;
+    grid.resolution = resolution;
+    for (int axis = 0; axis < 3; axis++)
+    {
+        grid.origin[axis] = min[axis];
+        grid.size[axis] = std::max(1, static_cast<int>(std::ceil((max[axis] - min[axis]) / resolution)));
+    }
+    grid.occupied.assign(static_cast<std::size_t>(grid.size[0]) * grid.size[1] * grid.size[2], false);
+    grid.used.assign(grid.occupied.size(), false);
+
+    // sample each triangle at half the resolution
+    for (auto const &triangle : mesh.triangles)
+    {
+        auto const &a = mesh.vertices[triangle.vertex_indices[0]];
+        auto const &b = mesh.vertices[triangle.vertex_indices[1]];
+        auto const &c = mesh.vertices[triangle.vertex_indices[2]];
+
+        double longest = std::max({distance(a, b), distance(b, c), distance(c, a)});
+        int steps = std::max(1, static_cast<int>(std::ceil(2.0 * longest / resolution)));
+
+        for (int i = 0; i <= steps; i++)
+        {
+            for (int j = 0; i + j <= steps; j++)
+            {
+                double u = static_cast<double>(i) / steps;
+                double v = static_cast<double>(j) / steps;
+                grid.mark(a.x + u * (b.x - a.x) + v * (c.x - a.x),
+                          a.y + u * (b.y - a.y) + v * (c.y - a.y),
+                          a.z + u * (b.z - a.z) + v * (c.z - a.z));
+            }
+        }
+    }
+
+    // greedy merge of the occupied voxels into boxes
+    for (int z = 0; z < grid.size[2]; z++)
+    {
+        for (int y = 0; y < grid.size[1]; y++)
+        {
+            for (int x = 0; x < grid.size[0]; x++)
+            {
+                if (grid.free(x, y, z))
+                    continue;
+
+                int x_end = x + 1;
+                while (x_end < grid.size[0] && !grid.free(x_end, y, z))
+                    x_end++;
+
+                auto row_occupied = [&](int row, int layer)
+                {
+                    for (int i = x; i < x_end; i++)
+                        if (grid.free(i, row, layer))
+                            return false;
+                    return true;
+                };
+
+                int y_end = y + 1;
+                while (y_end < grid.size[1] && row_occupied(y_end, z))
+                    y_end++;
+
+                int z_end = z + 1;
+                while (z_end < grid.size[2])
+                {
+                    bool layer_occupied = true;
+                    for (int j = y; j < y_end && layer_occupied; j++)
+                        layer_occupied = row_occupied(j, z_end);
+                    if (!layer_occupied)
+                        break;
+                    z_end++;
+                }
+
+                for (int k = z; k < z_end; k++)
+                    for (int j = y; j < y_end; j++)
+                        for (int i = x; i < x_end; i++)
+                            grid.used[grid.index(i, j, k)] = true;
+
+                shape_msgs::msg::SolidPrimitive box;
+                box.type = box.BOX;
+                box.dimensions = {(x_end - x) * resolution, (y_end - y) * resolution, (z_end - z) * resolution};
+
+                geometry_msgs::msg::Pose pose;
+                pose.position.x = grid.origin[0] + 0.5 * (x + x_end) * resolution;
+                pose.position.y = grid.origin[1] + 0.5 * (y + y_end) * resolution;
+                pose.position.z = grid.origin[2] + 0.5 * (z + z_end) * resolution;
+                pose.orientation.w = 1.0;
+
+                proxy.primitives.push_back(box);
+                proxy.primitive_poses.push_back(pose);
+            }
+        }
+    }
+
+    return proxy;
+}
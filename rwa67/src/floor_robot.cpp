@@ -22,9 +22,155 @@ FloorRobot::FloorRobot()
         RCLCPP_ERROR(this->get_logger(), "Floor Robot State Monitor Failed to Start");
     }
 
+    // plans the next segment of a pipeline while floor_robot_ executes, MoveGroupInterface is not thread-safe
+    lookahead_robot_ = std::make_shared<moveit::planning_interface::MoveGroupInterface>(node_, mgi_options);
+
     // use upper joint velocity and acceleration limits
-    floor_robot_->setMaxAccelerationScalingFactor(1.0);
-    floor_robot_->setMaxVelocityScalingFactor(1.0);
+    for (auto const &group : {floor_robot_, lookahead_robot_})
+    {
+        group->setMaxAccelerationScalingFactor(1.0);
+        group->setMaxVelocityScalingFactor(1.0);
+    }
+
+    // trajectory cache for Cartesian motions
+    this->declare_parameter("trajectory_cache.enabled", true);
+    this->declare_parameter("trajectory_cache.start_tolerance", 0.01);
+    use_trajectory_cache_ = this->get_parameter("trajectory_cache.enabled").as_bool();
+    trajectory_cache_start_tolerance_ = this->get_parameter("trajectory_cache.start_tolerance").as_double();
+    // start states within the tolerance share the key of a stored trajectory
+    trajectory_cache_ = std::make_unique<TrajectoryCache>(256, trajectory_cache_start_tolerance_);
+
+    // multi-segment motions
+    this->declare_parameter("pipeline.commit_tolerance", 0.01);
+    this->declare_parameter("blending.enabled", false);
+    this->declare_parameter("blending.ramp_time", 0.5);
+    this->declare_parameter("blending.path_tolerance", 0.01);
+    this->declare_parameter("blending.start_tolerance", 0.01);
+    pipeline_commit_tolerance_ = this->get_parameter("pipeline.commit_tolerance").as_double();
+    use_blending_ = this->get_parameter("blending.enabled").as_bool();
+    blend_ramp_time_ = this->get_parameter("blending.ramp_time").as_double();
+    blend_path_tolerance_ = this->get_parameter("blending.path_tolerance").as_double();
+    blend_start_tolerance_ = this->get_parameter("blending.start_tolerance").as_double();
+
+    // planning attempts of joint-space motions, OMPL runs the attempts of a request in parallel and keeps the shortest
+    this->declare_parameter("planning_attempts.count", 1);
+    this->declare_parameter("planning_attempts.planner_id", "");
+    this->declare_parameter("planning_attempts.time", 5.0);
+    auto planner_id = this->get_parameter("planning_attempts.planner_id").as_string();
+    for (auto const &group : {floor_robot_, lookahead_robot_})
+    {
+        group->setNumPlanningAttempts(this->get_parameter("planning_attempts.count").as_int());
+        group->setPlanningTime(this->get_parameter("planning_attempts.time").as_double());
+        if (!planner_id.empty())
+            group->setPlannerId(planner_id);
+    }
+
+    // grasp descent
+    this->declare_parameter("grasp_descent.max_depth", 0.05);
+    grasp_descent_max_depth_ = this->get_parameter("grasp_descent.max_depth").as_double();
+
+    // velocity/acceleration scaling of each class of motions, see config/motion_profiles.yaml
+    std::map<MotionClass, MotionProfile> default_profiles{
+        {MotionClass::FREE_TRANSIT, {1.0, 1.0, 0.0}},
+        {MotionClass::APPROACH, {0.3, 0.3, 0.0}},
+        {MotionClass::APPROACH_WITH_PART, {0.3, 0.3, 0.0}},
+        {MotionClass::APPROACH_WITH_TRAY, {0.2, 0.1, 0.0}},
+        {MotionClass::GRASP_DESCENT, {0.1, 0.1, 0.01}},
+        {MotionClass::RETREAT, {0.2, 0.1, 0.0}},
+        {MotionClass::PART_REMOVAL_DESCENT, {0.1, 0.1, 0.02}},
+        {MotionClass::LIFT, {0.3, 0.3, 0.0}},
+        {MotionClass::TRAY_LIFT, {0.2, 0.2, 0.0}},
+        {MotionClass::TOOL_CHANGE, {0.2, 0.1, 0.0}}};
+    for (auto const &default_profile : default_profiles)
+    {
+        std::string prefix = "motion_profiles." + MotionProfileTable::class_name(default_profile.first);
+        this->declare_parameter(prefix + ".velocity_scaling", default_profile.second.vsf);
+        this->declare_parameter(prefix + ".acceleration_scaling", default_profile.second.asf);
+        this->declare_parameter(prefix + ".max_speed", default_profile.second.max_speed);
+
+        MotionProfile profile;
+        profile.vsf = this->get_parameter(prefix + ".velocity_scaling").as_double();
+        profile.asf = this->get_parameter(prefix + ".acceleration_scaling").as_double();
+        profile.max_speed = this->get_parameter(prefix + ".max_speed").as_double();
+        motion_profiles_.set_profile(default_profile.first, profile);
+    }
+
+    // calibration mode: sweep the profiles upwards during normal operation
+    this->declare_parameter("motion_profiles.calibration.enabled", false);
+    this->declare_parameter("motion_profiles.calibration.step", 0.25);
+    this->declare_parameter("motion_profiles.calibration.max_multiplier", 4.0);
+    this->declare_parameter("motion_profiles.calibration.trials", 3);
+    this->declare_parameter("motion_profiles.calibration.max_tracking_error", 0.01);
+    this->declare_parameter("motion_profiles.calibration.output_file", "");
+    motion_profiles_file_ = this->get_parameter("motion_profiles.calibration.output_file").as_string();
+    if (this->get_parameter("motion_profiles.calibration.enabled").as_bool())
+    {
+        motion_profiles_.start_calibration(
+            this->get_parameter("motion_profiles.calibration.step").as_double(),
+            this->get_parameter("motion_profiles.calibration.max_multiplier").as_double(),
+            this->get_parameter("motion_profiles.calibration.trials").as_int(),
+            this->get_parameter("motion_profiles.calibration.max_tracking_error").as_double());
+        RCLCPP_WARN(this->get_logger(), "Motion profile calibration enabled");
+    }
+
+    // longest wait for a frame that is not in the frame pose cache
+    this->declare_parameter("frame_cache.lookup_timeout", 1.0);
+    frame_lookup_timeout_ = this->get_parameter("frame_cache.lookup_timeout").as_double();
+
+    // deadlines of the waits of complete_orders_()
+    this->declare_parameter("orders.wait_timeout", 10.0);
+    this->declare_parameter("orders.agv_timeout", 60.0);
+    order_wait_timeout_ = this->get_parameter("orders.wait_timeout").as_double();
+    agv_wait_timeout_ = this->get_parameter("orders.agv_timeout").as_double();
+    this->declare_parameter("quality_check.timeout", 10.0);
+    this->declare_parameter("quality_check.max_rounds", 2);
+    this->declare_parameter("quality_check.poll_period", 0.5);
+    quality_check_timeout_ = this->get_parameter("quality_check.timeout").as_double();
+    quality_check_max_rounds_ = this->get_parameter("quality_check.max_rounds").as_int();
+    quality_check_poll_period_ = this->get_parameter("quality_check.poll_period").as_double();
+
+    // planning of the parts of all the pending kits at once, the times are priors refined by the executed moves
+    this->declare_parameter("batch_planning.enabled", false);
+    this->declare_parameter("batch_planning.seconds_per_move", 1.0);
+    this->declare_parameter("batch_planning.seconds_per_meter", 1.0);
+    this->declare_parameter("batch_planning.seconds_per_gripper_change", 15.0);
+    this->declare_parameter("batch_planning.place_trays", true);
+    this->declare_parameter("batch_planning.tray_first", true);
+    this->declare_parameter("batch_planning.max_failures", 3);
+    batch_planning_ = this->get_parameter("batch_planning.enabled").as_bool();
+    batch_place_trays_ = this->get_parameter("batch_planning.place_trays").as_bool();
+    batch_max_failures_ = this->get_parameter("batch_planning.max_failures").as_int();
+    rail_costs_ = std::make_unique<RailCostModel>(
+        this->get_parameter("batch_planning.seconds_per_move").as_double(),
+        this->get_parameter("batch_planning.seconds_per_meter").as_double(),
+        this->get_parameter("batch_planning.seconds_per_gripper_change").as_double());
+    batch_planner_ = std::make_unique<BatchPlanner>(*rail_costs_,
+                                                    floor_kts1_js_["linear_actuator_joint"],
+                                                    floor_kts2_js_["linear_actuator_joint"],
+                                                    this->get_parameter("batch_planning.tray_first").as_bool());
+
+    // vertical approach and retreat moves
+    this->declare_parameter("vertical_moves.enabled", true);
+    this->declare_parameter("vertical_moves.min_conditioning", 0.05);
+    this->declare_parameter("vertical_moves.max_joint_step", 0.1);
+    use_vertical_moves_ = this->get_parameter("vertical_moves.enabled").as_bool();
+    vertical_move_generator_ = std::make_unique<VerticalMoveGenerator>(
+        floor_robot_->getRobotModel()->getJointModelGroup(floor_robot_->getName()),
+        floor_robot_->getEndEffectorLink(),
+        0.01, 0.001, 0.01,
+        this->get_parameter("vertical_moves.min_conditioning").as_double(),
+        this->get_parameter("vertical_moves.max_joint_step").as_double());
+
+    // local copy of the planning scene, used to validate cached trajectories
+    planning_scene_monitor_ = std::make_shared<planning_scene_monitor::PlanningSceneMonitor>(
+        node_, "robot_description", "floor_robot_scene_monitor");
+    planning_scene_monitor_->startSceneMonitor(planning_scene_monitor::PlanningSceneMonitor::MONITORED_PLANNING_SCENE_TOPIC);
+    if (!planning_scene_monitor_->requestPlanningSceneState())
+    {
+        RCLCPP_WARN(this->get_logger(), "Unable to get the initial planning scene from move_group");
+    }
+    // joint states, read in place by refresh_current_state_
+    planning_scene_monitor_->startStateMonitor();
 
     // callback groups
     rclcpp::SubscriptionOptions options;
@@ -43,6 +189,8 @@ FloorRobot::FloorRobot()
     // subscription to /ariac/orders
     orders_sub_ = this->create_subscription<ariac_msgs::msg::Order>("/ariac/orders", 1,
                                                                     std::bind(&FloorRobot::orders_cb, this, std::placeholders::_1), options);
+    // orders submitted by shipping_
+    submitted_order_pub_ = this->create_publisher<std_msgs::msg::String>("/ariac/submitted_order", 10);
     // subscription to /ariac/competition_state
     competition_state_sub_ = this->create_subscription<ariac_msgs::msg::CompetitionState>(
         "/ariac/competition_state", 1,
@@ -94,7 +242,11 @@ FloorRobot::FloorRobot()
         std::bind(&FloorRobot::agv4_status_cb, this, std::placeholders::_1), options);
 
     // client to /ariac/perform_quality_check
-    quality_checker_ = this->create_client<ariac_msgs::srv::PerformQualityCheck>("/ariac/perform_quality_check");
+    // its responses are handled while the order thread works, in their own callback group
+    quality_cbg_ = create_callback_group(rclcpp::CallbackGroupType::MutuallyExclusive);
+    quality_checker_ = this->create_client<ariac_msgs::srv::PerformQualityCheck>(
+        "/ariac/perform_quality_check", rmw_qos_profile_services_default, quality_cbg_);
+    quality_checks_ = std::make_unique<QualityCheckStage>(quality_checker_);
     // client to /ariac/floor_robot_change_gripper
     floor_robot_tool_changer_ = this->create_client<ariac_msgs::srv::ChangeGripper>("/ariac/floor_robot_change_gripper");
     // client to /ariac/floor_robot_enable_gripper
@@ -164,6 +316,73 @@ FloorRobot::FloorRobot()
         server_cbg_
     );
 
+    // service to report the trajectory cache counters
+    motion_cache_stats_srv_ = create_service<std_srvs::srv::Trigger>(
+        "/commander/motion_cache_stats",
+        std::bind(
+            &FloorRobot::motion_cache_stats_srv_cb_, this,
+            std::placeholders::_1, std::placeholders::_2),
+        rmw_qos_profile_services_default,
+        server_cbg_);
+
+    // service to report the motion profiles
+    motion_profiles_srv_ = create_service<std_srvs::srv::Trigger>(
+        "/commander/motion_profiles",
+        std::bind(
+            &FloorRobot::motion_profiles_srv_cb_, this,
+            std::placeholders::_1, std::placeholders::_2),
+        rmw_qos_profile_services_default,
+        server_cbg_);
+
+    // service to report the heap allocations of the motion hot path
+    motion_allocations_srv_ = create_service<std_srvs::srv::Trigger>(
+        "/commander/motion_allocations",
+        std::bind(
+            &FloorRobot::motion_allocations_srv_cb_, this,
+            std::placeholders::_1, std::placeholders::_2),
+        rmw_qos_profile_services_default,
+        server_cbg_);
+
+    // service to report the dynamic objects of the planning scene
+    scene_objects_srv_ = create_service<std_srvs::srv::Trigger>(
+        "/commander/scene_objects",
+        std::bind(
+            &FloorRobot::scene_objects_srv_cb_, this,
+            std::placeholders::_1, std::placeholders::_2),
+        rmw_qos_profile_services_default,
+        server_cbg_);
+
+    // service to compare planning with and without the collision proxies
+    benchmark_collision_proxies_srv_ = create_service<std_srvs::srv::Trigger>(
+        "/commander/benchmark_collision_proxies",
+        std::bind(
+            &FloorRobot::benchmark_collision_proxies_srv_cb_, this,
+            std::placeholders::_1, std::placeholders::_2),
+        rmw_qos_profile_services_default,
+        server_cbg_);
+
+    // service to compare the vertical move generator with computeCartesianPath
+    benchmark_vertical_moves_srv_ = create_service<std_srvs::srv::Trigger>(
+        "/commander/benchmark_vertical_moves",
+        std::bind(
+            &FloorRobot::benchmark_vertical_moves_srv_cb_, this,
+            std::placeholders::_1, std::placeholders::_2),
+        rmw_qos_profile_services_default,
+        server_cbg_);
+
+    // collision meshes of the workcell models, loaded once
+    auto mesh_count = mesh_registry_.load_directory(
+        ament_index_cpp::get_package_share_directory("rwa67") + "/meshes");
+    RCLCPP_INFO_STREAM(get_logger(), "Loaded " << mesh_count << " collision meshes");
+
+    // box proxies of the static models
+    this->declare_parameter("collision_proxies.enabled", false);
+    this->declare_parameter("collision_proxies.resolution", 0.02);
+    use_collision_proxies_ = this->get_parameter("collision_proxies.enabled").as_bool();
+    auto proxy_boxes = mesh_registry_.build_proxies(this->get_parameter("collision_proxies.resolution").as_double());
+    RCLCPP_INFO_STREAM(get_logger(), "Built collision proxies (" << proxy_boxes << " boxes), "
+                                     << (use_collision_proxies_ ? "used" : "not used") << " for the static models");
+
     // add models to the planning scene
     add_models_to_planning_scene_();
 
@@ -171,6 +390,19 @@ FloorRobot::FloorRobot()
     executor_thread_ = std::thread([this]()
                                    { this->executor_->spin(); });
 
+    // precompute the trajectories between the canonical configurations
+    this->declare_parameter("roadmap.enabled", true);
+    this->declare_parameter("roadmap.snap_tolerance", 0.1);
+    use_roadmap_ = this->get_parameter("roadmap.enabled").as_bool();
+    roadmap_ = std::make_unique<MotionRoadmap>(this->get_parameter("roadmap.snap_tolerance").as_double());
+    motion_plan_client_ = node_->create_client<moveit_msgs::srv::GetMotionPlan>("/plan_kinematic_path");
+    if (use_roadmap_)
+    {
+        add_roadmap_nodes_();
+        roadmap_thread_ = std::thread([this]()
+                                      { this->build_roadmap_(); });
+    }
+
     RCLCPP_INFO(this->get_logger(), "Initialization successful.");
     RCLCPP_INFO(this->get_logger(), "Waiting for Service calls.");
 }
@@ -178,6 +410,11 @@ FloorRobot::FloorRobot()
 //=============================================//
 FloorRobot::~FloorRobot()
 {
+    shutting_down_ = true;
+    shipping_.cancel();
+    if (roadmap_thread_.joinable())
+        roadmap_thread_.join();
+
     floor_robot_->~MoveGroupInterface();
 }
 
@@ -201,6 +438,348 @@ void FloorRobot::move_robot_home_srv_cb_(
     }
 }
 
+//=============================================//
+void FloorRobot::motion_cache_stats_srv_cb_(
+    std_srvs::srv::Trigger::Request::SharedPtr request,
+    std_srvs::srv::Trigger::Response::SharedPtr response)
+{
+    (void)request; // remove unused parameter warning
+
+    auto stats = trajectory_cache_->stats();
+    std::stringstream message;
+    message << "hits: " << stats.hits
+            << ", misses: " << stats.misses
+            << ", rejected: " << stats.rejected
+            << ", saved planning time: " << stats.saved_planning_time << " s"
+            << ", stored trajectories: " << trajectory_cache_->size();
+
+    auto frame_stats = frame_pose_cache_.stats();
+    message << "; frame poses served from the cache: " << frame_stats.hits
+            << ", TF lookups: " << frame_stats.lookups
+            << ", failed lookups: " << frame_stats.failures;
+
+    // the camera frames used to copy the bytes now shared
+    auto world_stats = world_.stats();
+    double seconds = world_stats.seconds > 0.0 ? world_stats.seconds : 1.0;
+    message << "; camera frames: " << world_stats.frames
+            << ", bytes/s shared: " << static_cast<uint64_t>(world_stats.bytes_shared / seconds)
+            << ", bytes/s copied: " << static_cast<uint64_t>(world_stats.bytes_copied / seconds);
+    message << "; rail moves: " << rail_costs_->report();
+
+    response->success = true;
+    response->message = message.str();
+}
+
+//=============================================//
+void FloorRobot::motion_profiles_srv_cb_(
+    std_srvs::srv::Trigger::Request::SharedPtr request,
+    std_srvs::srv::Trigger::Response::SharedPtr response)
+{
+    (void)request; // remove unused parameter warning
+
+    save_motion_profiles_();
+    response->success = true;
+    response->message = (motion_profiles_.calibrating() ? "calibrating, " : "") + motion_profiles_.report();
+}
+
+//=============================================//
+void FloorRobot::record_motion_outcome_(MotionClass motion_class, bool success, const moveit_msgs::msg::RobotTrajectory &trajectory)
+{
+    // moves along the rail refine the time model of the batch planner
+    auto const &joint_trajectory = trajectory.joint_trajectory;
+    auto rail_joint = std::find(joint_trajectory.joint_names.begin(), joint_trajectory.joint_names.end(), "linear_actuator_joint");
+    if (success && rail_joint != joint_trajectory.joint_names.end() && joint_trajectory.points.size() > 1)
+    {
+        auto index = rail_joint - joint_trajectory.joint_names.begin();
+        auto const &last = joint_trajectory.points.back();
+        double distance = std::abs(last.positions[index] - joint_trajectory.points.front().positions[index]);
+        if (distance > 0.05)
+            rail_costs_->record(distance, rclcpp::Duration(last.time_from_start).seconds());
+    }
+
+    if (!motion_profiles_.calibrating())
+        return;
+
+    // the grasp descents are stopped on purpose before their end
+    double tracking_error = 0.0;
+    if (motion_class != MotionClass::GRASP_DESCENT && motion_class != MotionClass::PART_REMOVAL_DESCENT)
+    {
+        auto current_state = floor_robot_->getCurrentState();
+        tracking_error = joint_distance_(*current_state, trajectory_end_state_(trajectory, *current_state));
+    }
+
+    if (motion_profiles_.record(motion_class, success, tracking_error))
+    {
+        RCLCPP_INFO_STREAM(get_logger(), "Motion profile " << MotionProfileTable::class_name(motion_class)
+                                                           << (success ? " validated" : " failed")
+                                                           << " (tracking error " << tracking_error << ")");
+        save_motion_profiles_();
+    }
+}
+
+//=============================================//
+void FloorRobot::save_motion_profiles_()
+{
+    std::string yaml = motion_profiles_.to_yaml(get_name());
+    if (motion_profiles_file_.empty())
+    {
+        RCLCPP_INFO_STREAM(get_logger(), "Motion profiles:\n" << yaml);
+        return;
+    }
+
+    std::ofstream file(motion_profiles_file_);
+    file << yaml;
+    if (!file)
+        RCLCPP_ERROR_STREAM(get_logger(), "Unable to write the motion profiles to " << motion_profiles_file_);
+}
+
+//=============================================//
+void FloorRobot::motion_allocations_srv_cb_(
+    std_srvs::srv::Trigger::Request::SharedPtr request,
+    std_srvs::srv::Trigger::Response::SharedPtr response)
+{
+    (void)request; // remove unused parameter warning
+
+    std::vector<std::pair<std::string, allocation_counter::Stats>> operations;
+    {
+        std::lock_guard<std::mutex> lock(allocations_mutex_);
+        operations = {{"move_to_target_", move_to_target_allocations_},
+                      {"move_through_waypoints_", move_through_waypoints_allocations_}};
+    }
+
+    std::stringstream message;
+    for (auto const &operation : operations)
+    {
+        auto const &stats = operation.second;
+        message << operation.first << ": " << stats.calls << " calls";
+        if (stats.calls > 0)
+            message << ", allocations per call min " << stats.min << " / last " << stats.last
+                    << " / max " << stats.max << " / mean " << stats.total / stats.calls;
+        message << "; ";
+    }
+
+    response->success = true;
+    response->message = message.str();
+}
+
+//=============================================//
+void FloorRobot::scene_objects_srv_cb_(
+    std_srvs::srv::Trigger::Request::SharedPtr request,
+    std_srvs::srv::Trigger::Response::SharedPtr response)
+{
+    (void)request; // remove unused parameter warning
+
+    response->success = true;
+    response->message = scene_objects_.report();
+}
+
+//=============================================//
+void FloorRobot::benchmark_vertical_moves_srv_cb_(
+    std_srvs::srv::Trigger::Request::SharedPtr request,
+    std_srvs::srv::Trigger::Response::SharedPtr response)
+{
+    (void)request; // remove unused parameter warning
+
+    auto start_state = *floor_robot_->getCurrentState();
+    auto start_pose = floor_robot_->getCurrentPose().pose;
+
+    // Retreat heights used by the commander, each followed by the approach back down
+    std::vector<std::pair<std::string, std::vector<geometry_msgs::msg::Pose>>> waypoint_sets;
+    for (double height : {0.1, 0.2, 0.3, 0.4, 0.5})
+    {
+        geometry_msgs::msg::Pose above = start_pose;
+        above.position.z += height;
+
+        std::stringstream name;
+        name << "up " << height;
+        waypoint_sets.push_back({name.str(), {above}});
+        name << " and down";
+        waypoint_sets.push_back({name.str(), {above, start_pose}});
+    }
+
+    const int repetitions = 5;
+    double generator_total = 0.0;
+    double cartesian_total = 0.0;
+    std::stringstream message;
+    for (auto const &waypoint_set : waypoint_sets)
+    {
+        double generator_time = 0.0;
+        double cartesian_time = 0.0;
+        bool generator_success = true;
+        bool cartesian_success = true;
+        for (int i = 0; i < repetitions; i++)
+        {
+            moveit_msgs::msg::RobotTrajectory trajectory;
+
+            auto generator_start = std::chrono::steady_clock::now();
+            generator_success &= plan_vertical_move_(waypoint_set.second, start_state, trajectory);
+            std::chrono::duration<double> generator_elapsed = std::chrono::steady_clock::now() - generator_start;
+            generator_time += generator_elapsed.count();
+
+            auto cartesian_start = std::chrono::steady_clock::now();
+            floor_robot_->setStartState(start_state);
+            cartesian_success &= floor_robot_->computeCartesianPath(waypoint_set.second, 0.01, 0.0, trajectory) >= 0.9;
+            floor_robot_->setStartStateToCurrentState();
+            std::chrono::duration<double> cartesian_elapsed = std::chrono::steady_clock::now() - cartesian_start;
+            cartesian_time += cartesian_elapsed.count();
+        }
+        generator_time /= repetitions;
+        cartesian_time /= repetitions;
+        generator_total += generator_time;
+        cartesian_total += cartesian_time;
+
+        message << waypoint_set.first << ": generator " << generator_time * 1000.0 << " ms"
+                << (generator_success ? "" : " (failed)")
+                << ", computeCartesianPath " << cartesian_time * 1000.0 << " ms"
+                << (cartesian_success ? "" : " (failed)") << "; ";
+    }
+    message << "total: generator " << generator_total * 1000.0 << " ms, computeCartesianPath "
+            << cartesian_total * 1000.0 << " ms";
+
+    RCLCPP_INFO_STREAM(get_logger(), "Vertical move benchmark: " << message.str());
+    response->success = true;
+    response->message = message.str();
+}
+
+//=============================================//
+void FloorRobot::benchmark_collision_proxies_srv_cb_(
+    std_srvs::srv::Trigger::Request::SharedPtr request,
+    std_srvs::srv::Trigger::Response::SharedPtr response)
+{
+    (void)request; // remove unused parameter warning
+
+    auto start_state = *floor_robot_->getCurrentState();
+    auto start_pose = floor_robot_->getCurrentPose().pose;
+
+    // Canonical joint-space motions of the commander, from the current state
+    std::vector<std::pair<std::string, std::map<std::string, double>>> targets{
+        {"kts1", floor_kts1_js_},
+        {"kts2", floor_kts2_js_}};
+    for (auto const &rail_position : rail_positions_)
+        targets.push_back({rail_position.first, {{"linear_actuator_joint", rail_position.second}, {"floor_shoulder_pan_joint", 0.0}}});
+
+    // Canonical Cartesian motion: retreat and approach back down
+    geometry_msgs::msg::Pose above = start_pose;
+    above.position.z += 0.3;
+    std::vector<geometry_msgs::msg::Pose> waypoints{above, start_pose};
+
+    // the trays and parts added while working, restored if the swap drops them
+    auto dynamic_objects = planning_scene_.getObjects();
+
+    const int repetitions = 3;
+    bool configured = use_collision_proxies_;
+    std::stringstream message;
+    for (bool proxies : {false, true})
+    {
+        // swap the geometry of the static models, an ADD replaces an existing object
+        use_collision_proxies_ = proxies;
+        {
+            std::lock_guard<std::mutex> lock(scene_models_mutex_);
+            scene_models_.clear();
+        }
+        PlanningSceneBuilder builder;
+        stage_static_models_(builder);
+        if (!flush_scene_(builder))
+        {
+            response->success = false;
+            response->message = "Unable to apply the static models";
+            use_collision_proxies_ = configured;
+            restore_scene_objects_(dynamic_objects);
+            return;
+        }
+        // trajectories stored meanwhile were checked against the other geometry
+        trajectory_cache_->clear();
+
+        int attempts = 0;
+        int successes = 0;
+        double planning_time = 0.0;
+        double cartesian_time = 0.0;
+        int cartesian_successes = 0;
+        for (int i = 0; i < repetitions; i++)
+        {
+            for (auto const &target : targets)
+            {
+                moveit::planning_interface::MoveGroupInterface::Plan plan;
+                floor_robot_->setStartState(start_state);
+                floor_robot_->setJointValueTarget(target.second);
+
+                auto plan_start = std::chrono::steady_clock::now();
+                bool success = static_cast<bool>(floor_robot_->plan(plan));
+                std::chrono::duration<double> plan_elapsed = std::chrono::steady_clock::now() - plan_start;
+
+                attempts++;
+                successes += success;
+                planning_time += plan_elapsed.count();
+            }
+
+            moveit_msgs::msg::RobotTrajectory trajectory;
+            floor_robot_->setStartState(start_state);
+            auto cartesian_start = std::chrono::steady_clock::now();
+            cartesian_successes += floor_robot_->computeCartesianPath(waypoints, 0.01, 0.0, trajectory) >= 0.9;
+            std::chrono::duration<double> cartesian_elapsed = std::chrono::steady_clock::now() - cartesian_start;
+            cartesian_time += cartesian_elapsed.count();
+        }
+        floor_robot_->setStartStateToCurrentState();
+
+        message << (proxies ? "proxies" : "meshes") << ": planning " << planning_time / attempts * 1000.0
+                << " ms per motion, " << successes << "/" << attempts << " succeeded; computeCartesianPath "
+                << cartesian_time / repetitions * 1000.0 << " ms, " << cartesian_successes << "/" << repetitions
+                << " succeeded; ";
+    }
+
+    // restore the configured geometry
+    use_collision_proxies_ = configured;
+    {
+        std::lock_guard<std::mutex> lock(scene_models_mutex_);
+        scene_models_.clear();
+    }
+    PlanningSceneBuilder builder;
+    stage_static_models_(builder);
+    flush_scene_(builder);
+    trajectory_cache_->clear();
+    restore_scene_objects_(dynamic_objects);
+
+    RCLCPP_INFO_STREAM(get_logger(), "Collision proxy benchmark: " << message.str());
+    response->success = true;
+    response->message = message.str();
+}
+
+//=============================================//
+void FloorRobot::restore_scene_objects_(const std::map<std::string, moveit_msgs::msg::CollisionObject> &objects)
+{
+    auto known = planning_scene_.getKnownObjectNames();
+    auto attached = planning_scene_.getAttachedObjects();
+
+    // objects still tracked by scene_objects_ that are neither in the world nor held
+    std::vector<moveit_msgs::msg::CollisionObject> missing;
+    for (auto const &object : objects)
+    {
+        if (scene_objects_.state(object.first) == SceneObjectState::REMOVED ||
+            std::find(known.begin(), known.end(), object.first) != known.end() ||
+            attached.count(object.first))
+            continue;
+
+        missing.push_back(object.second);
+        missing.back().operation = moveit_msgs::msg::CollisionObject::ADD;
+    }
+
+    if (missing.empty())
+        return;
+
+    RCLCPP_WARN_STREAM(get_logger(), "Restoring " << missing.size() << " objects of the planning scene");
+    if (!planning_scene_.applyCollisionObjects(missing))
+        RCLCPP_ERROR(get_logger(), "Unable to restore the objects of the planning scene");
+}
+
+//=============================================//
+void FloorRobot::log_trajectory_cache_stats_()
+{
+    auto stats = trajectory_cache_->stats();
+    RCLCPP_INFO_STREAM(get_logger(), "Trajectory cache: " << stats.hits << " hits, " << stats.misses << " misses, "
+                                                          << stats.rejected << " rejected, "
+                                                          << stats.saved_planning_time << " s of planning saved");
+}
+
 //=============================================//
 bool FloorRobot::move_robot_home_()
 {
@@ -242,8 +821,7 @@ bool FloorRobot::move_robot_to_table_(int kts)
         return false;
     }
 
-    move_to_target_();
-    return true;
+    return move_to_target_();
 }
 
 //=============================================//
@@ -293,9 +871,6 @@ bool FloorRobot::pickup_part(geometry_msgs::msg::Pose &part_pose_, int part_type
 {
     double part_rotation = Utils::get_yaw_from_pose_(part_pose_);
 
-    floor_robot_->setJointValueTarget("linear_actuator_joint", -part_pose_.position.y);
-    move_to_target_();
-
     std::vector<geometry_msgs::msg::Pose> waypoints;
     part_rotation = 0.0;
     waypoints.push_back(Utils::build_pose(part_pose_.position.x, part_pose_.position.y,
@@ -304,19 +879,24 @@ bool FloorRobot::pickup_part(geometry_msgs::msg::Pose &part_pose_, int part_type
     waypoints.push_back(Utils::build_pose(part_pose_.position.x, part_pose_.position.y,
                                           part_pose_.position.z + part_heights_[part_type_] + pick_offset_, set_robot_orientation_(part_rotation)));
 
-    if (!move_through_waypoints_(waypoints, 0.3, 0.3))
+    // The approach is blended with the rail move, or planned while the rail moves
+    std::vector<MotionSegment> segments;
+    segments.push_back(MotionSegment{"rail to part", {{"linear_actuator_joint", -part_pose_.position.y}}, {}});
+    segments.push_back(MotionSegment{"approach part", {}, waypoints, MotionClass::APPROACH});
+
+    if (!move_transit_and_approach_(segments[0], segments[1]))
     {
         RCLCPP_ERROR(get_logger(), "Unable to move robot above tray");
         return false;
     }
 
     wait_for_attach_completion_(5.0);
-    if (floor_gripper_state_.attached)
+    if (floor_gripper_state_.snapshot()->attached)
     {
-        // Add part to planning scene
+        // Add part to planning scene, each physical part gets its own id
         std::string part_name = part_colors_[part_color_] + "_" + part_types_[part_type_];
-        // add_single_model_to_planning_scene_(part_name, part_types_[part_type_] + ".stl", part_pose_);
-        floor_robot_->attachObject(part_name);
+        auto part_object_id = add_scene_object_(part_name, part_types_[part_type_] + ".stl", part_pose_);
+        attach_scene_object_(part_object_id);
 
         auto part_to_pick = ariac_msgs::msg::Part();
         part_to_pick.type = part_type_;
@@ -328,7 +908,7 @@ bool FloorRobot::pickup_part(geometry_msgs::msg::Pose &part_pose_, int part_type
         waypoints.clear();
         waypoints.push_back(Utils::build_pose(part_pose_.position.x, part_pose_.position.y,
                                           part_pose_.position.z + 0.3, set_robot_orientation_(part_rotation)));
-        move_through_waypoints_(waypoints, 0.3, 0.3);                        
+        move_through_waypoints_(waypoints, MotionClass::LIFT);
 
         return true;
     }
@@ -390,7 +970,7 @@ bool FloorRobot::move_robot_to_tray_(int tray_id, const geometry_msgs::msg::Pose
     waypoints.push_back(Utils::build_pose(tray_pose.position.x, tray_pose.position.y,
                                           tray_pose.position.z + pick_offset_, set_robot_orientation_(tray_rotation)));
 
-    if (!move_through_waypoints_(waypoints, 0.3, 0.3))
+    if (!move_through_waypoints_(waypoints, MotionClass::APPROACH))
     {
         RCLCPP_ERROR(get_logger(), "Unable to move robot above tray");
         return false;
@@ -401,24 +981,20 @@ bool FloorRobot::move_robot_to_tray_(int tray_id, const geometry_msgs::msg::Pose
     wait_for_attach_completion_(5.0);
 
     
-    if (floor_gripper_state_.attached){
+    if (floor_gripper_state_.snapshot()->attached){
 
-        // Add tray to planning scene
-        // TODO: This will generate all sorts of problems if "kit_tray_3" already exists in the planning scene
-        // It can happen that you need to build 2 kits and both use tray id 3.
-        // You should find a way to name each tray differently
-        std::string tray_name = "kit_tray_" + std::to_string(tray_id);
-        add_single_model_to_planning_scene_(tray_name, "kit_tray.stl", tray_pose);
+        // Add tray to planning scene, each physical tray gets its own id
+        auto tray_object_id = add_scene_object_("kit_tray_" + std::to_string(tray_id), "kit_tray.stl", tray_pose);
 
         // Attach tray to robot in planning scene
-        floor_robot_->attachObject(tray_name);
+        attach_scene_object_(tray_object_id);
 
         // Move up slightly
         waypoints.clear();
         waypoints.push_back(Utils::build_pose(tray_pose.position.x, tray_pose.position.y,
                                               tray_pose.position.z + 0.2, set_robot_orientation_(tray_rotation)));
 
-        if (!move_through_waypoints_(waypoints, 0.2, 0.2))
+        if (!move_through_waypoints_(waypoints, MotionClass::TRAY_LIFT))
         {
             RCLCPP_ERROR(get_logger(), "Unable to move up");
             return false;
@@ -461,7 +1037,9 @@ bool FloorRobot::move_tray_to_agv(int agv_number)
         return false;
     }
 
-    auto agv_tray_pose = get_pose_in_world_frame_("agv" + std::to_string(agv_number) + "_tray");
+    geometry_msgs::msg::Pose agv_tray_pose;
+    if (!get_pose_in_world_frame_("agv" + std::to_string(agv_number) + "_tray", agv_tray_pose))
+        return false;
     auto agv_rotation = Utils::get_yaw_from_pose_(agv_tray_pose);
 
     waypoints.clear();
@@ -471,7 +1049,7 @@ bool FloorRobot::move_tray_to_agv(int agv_number)
     waypoints.push_back(Utils::build_pose(agv_tray_pose.position.x, agv_tray_pose.position.y,
                                           agv_tray_pose.position.z + kit_tray_thickness_ + drop_height_, set_robot_orientation_(agv_rotation)));
 
-    if (!move_through_waypoints_(waypoints, 0.2, 0.1))
+    if (!move_through_waypoints_(waypoints, MotionClass::APPROACH_WITH_TRAY))
     {
         RCLCPP_ERROR(get_logger(), "Unable to move tray to AGV");
         return false;
@@ -506,7 +1084,9 @@ bool FloorRobot::enter_tool_changer_(std::string changing_station, std::string g
 {
 
     usleep(10000);
-    auto tc_pose = get_pose_in_world_frame_(changing_station + "_tool_changer_" + gripper_type + "_frame");
+    geometry_msgs::msg::Pose tc_pose;
+    if (!get_pose_in_world_frame_(changing_station + "_tool_changer_" + gripper_type + "_frame", tc_pose))
+        return false;
 
     RCLCPP_INFO_STREAM(get_logger(), "Tool changer pose: " << tc_pose.position.x << ", " << tc_pose.position.y << ", " << tc_pose.position.z);
     std::vector<geometry_msgs::msg::Pose> waypoints;
@@ -516,7 +1096,7 @@ bool FloorRobot::enter_tool_changer_(std::string changing_station, std::string g
     waypoints.push_back(Utils::build_pose(tc_pose.position.x, tc_pose.position.y,
                                           tc_pose.position.z, set_robot_orientation_(0.0)));
 
-    if (!move_through_waypoints_(waypoints, 0.3, 0.3))
+    if (!move_through_waypoints_(waypoints, MotionClass::APPROACH))
         return false;
 
     return true;
@@ -548,14 +1128,16 @@ void FloorRobot::exit_tool_changer_srv_cb_(
 bool FloorRobot::exit_tool_changer_(std::string changing_station, std::string gripper_type)
 {
     // Move gripper into tool changer
-    auto tc_pose = get_pose_in_world_frame_(changing_station + "_tool_changer_" + gripper_type + "_frame");
+    geometry_msgs::msg::Pose tc_pose;
+    if (!get_pose_in_world_frame_(changing_station + "_tool_changer_" + gripper_type + "_frame", tc_pose))
+        return false;
 
     std::vector<geometry_msgs::msg::Pose> waypoints;
 
     waypoints.push_back(Utils::build_pose(tc_pose.position.x, tc_pose.position.y,
                                           tc_pose.position.z + 0.4, set_robot_orientation_(0.0)));
 
-    if (!move_through_waypoints_(waypoints, 0.3, 0.3))
+    if (!move_through_waypoints_(waypoints, MotionClass::LIFT))
         return false;
 
     return true;
@@ -635,39 +1217,53 @@ bool FloorRobot::move_agv_(int agv_num, int destination)
     return result.get()->success;
 }
 
+//=============================================//
+void FloorRobot::update_agv_location_(int agv_num, int location)
+{
+    auto agv = "agv" + std::to_string(agv_num);
+
+    // the tray frame of the agv moves with it
+    if (agv_locations_.set(agv_num, location) != location)
+        frame_pose_cache_.invalidate(agv + "_tray");
+
+    // trays and parts leave the cell with the agv
+    if (location != ariac_msgs::msg::AGVStatus::KITTING)
+        collect_scene_objects_(agv);
+}
+
 //=============================================//
 void FloorRobot::agv1_status_cb(
     const ariac_msgs::msg::AGVStatus::ConstSharedPtr msg)
 {
-    agv_locations_[1] = msg->location;
+    update_agv_location_(1, msg->location);
 }
 
 //=============================================//
 void FloorRobot::agv2_status_cb(
     const ariac_msgs::msg::AGVStatus::ConstSharedPtr msg)
 {
-    agv_locations_[2] = msg->location;
+    update_agv_location_(2, msg->location);
 }
 
 //=============================================//
 void FloorRobot::agv3_status_cb(
     const ariac_msgs::msg::AGVStatus::ConstSharedPtr msg)
 {
-    agv_locations_[3] = msg->location;
+    update_agv_location_(3, msg->location);
 }
 
 //=============================================//
 void FloorRobot::agv4_status_cb(
     const ariac_msgs::msg::AGVStatus::ConstSharedPtr msg)
 {
-    agv_locations_[4] = msg->location;
+    update_agv_location_(4, msg->location);
 }
 
 //=============================================//
 void FloorRobot::orders_cb(
     const ariac_msgs::msg::Order::ConstSharedPtr msg)
 {
-    orders_.push_back(*msg);
+    orders_.push(*msg);
 }
 
 //=============================================//
@@ -692,6 +1288,16 @@ void FloorRobot::competition_state_cb(
     const ariac_msgs::msg::CompetitionState::ConstSharedPtr msg)
 {
     competition_state_ = msg->competition_state;
+
+    if (competition_state_ == ariac_msgs::msg::CompetitionState::ORDER_ANNOUNCEMENTS_DONE)
+        orders_.drain();
+
+    // nothing can be submitted anymore, release the order thread
+    if (competition_state_ == ariac_msgs::msg::CompetitionState::ENDED)
+    {
+        orders_.cancel();
+        agv_locations_.cancel();
+    }
 }
 
 //=============================================//
@@ -704,8 +1310,7 @@ void FloorRobot::kts1_camera_cb(
         kts1_camera_received_data = true;
     }
 
-    kts1_trays_ = msg->tray_poses;
-    kts1_camera_pose_ = msg->sensor_pose;
+    world_.publish(WorldCamera::KTS1, msg);
 }
 
 //=============================================//
@@ -718,8 +1323,7 @@ void FloorRobot::kts2_camera_cb(
         kts2_camera_received_data = true;
     }
 
-    kts2_trays_ = msg->tray_poses;
-    kts2_camera_pose_ = msg->sensor_pose;
+    world_.publish(WorldCamera::KTS2, msg);
 }
 
 //=============================================//
@@ -732,8 +1336,7 @@ void FloorRobot::left_bins_camera_cb(
         left_bins_camera_received_data = true;
     }
 
-    left_bins_parts_ = msg->part_poses;
-    left_bins_camera_pose_ = msg->sensor_pose;
+    world_.publish(WorldCamera::LEFT_BINS, msg);
 }
 
 //=============================================//
@@ -746,75 +1349,151 @@ void FloorRobot::right_bins_camera_cb(
         right_bins_camera_received_data = true;
     }
 
-    right_bins_parts_ = msg->part_poses;
-    right_bins_camera_pose_ = msg->sensor_pose;
+    world_.publish(WorldCamera::RIGHT_BINS, msg);
 }
 
 //=============================================//
 void FloorRobot::floor_gripper_state_cb(
     const ariac_msgs::msg::VacuumGripperState::ConstSharedPtr msg)
 {
-    floor_gripper_state_ = *msg;
-    // RCLCPP_INFO_STREAM(get_logger(), "Floor gripper state: " << floor_gripper_state_.attached);
+    floor_gripper_state_.publish(*msg);
+    // RCLCPP_INFO_STREAM(get_logger(), "Floor gripper state: " << msg->attached);
+
+    // end the grasp descent as soon as the object is attached
+    if (msg->attached && grasp_descent_active_.exchange(false))
+        floor_robot_->stop();
+}
+
+bool FloorRobot::get_pose_in_world_frame_(const std::string &frame_id, geometry_msgs::msg::Pose &pose)
+{
+    auto lookup = frame_pose_cache_.lookup(frame_id, frame_lookup_timeout_);
+    if (!lookup)
+    {
+        RCLCPP_ERROR_STREAM(get_logger(), "Could not get the pose of " << frame_id << " ("
+                                          << FramePoseCache::error_name(lookup.error) << "): " << lookup.message);
+        return false;
+    }
+
+    pose = *lookup.pose;
+    return true;
 }
 
-geometry_msgs::msg::Pose FloorRobot::get_pose_in_world_frame_(std::string frame_id)
+//=============================================//
+bool FloorRobot::stage_model_(
+    PlanningSceneBuilder &builder, const std::string &name, const std::string &mesh_file,
+    const geometry_msgs::msg::Pose &model_pose)
 {
-    geometry_msgs::msg::TransformStamped t;
-    geometry_msgs::msg::Pose pose;
+    bool known;
+    {
+        std::lock_guard<std::mutex> lock(scene_models_mutex_);
+        known = !scene_models_.insert(name).second;
+    }
 
-    try
+    if (known)
     {
-        t = tf_buffer->lookupTransform("world", frame_id, tf2::TimePointZero);
+        builder.move(name, model_pose);
+        return true;
     }
-    catch (const tf2::TransformException &ex)
+
+    auto proxy = mesh_registry_.proxy(mesh_file);
+    if (use_collision_proxies_ && proxy && !proxy->primitives.empty())
     {
-        RCLCPP_ERROR(get_logger(), "Could not get transform");
+        builder.add_primitives(name, proxy->primitives, proxy->primitive_poses, model_pose);
+        return true;
     }
 
-    pose.position.x = t.transform.translation.x;
-    pose.position.y = t.transform.translation.y;
-    pose.position.z = t.transform.translation.z;
-    pose.orientation = t.transform.rotation;
+    auto mesh = mesh_registry_.get(mesh_file);
+    if (!mesh)
+    {
+        RCLCPP_ERROR_STREAM(get_logger(), "Unknown mesh " << mesh_file << " for model " << name);
+        std::lock_guard<std::mutex> lock(scene_models_mutex_);
+        scene_models_.erase(name);
+        return false;
+    }
 
-    return pose;
+    builder.add_mesh(name, *mesh, model_pose);
+    return true;
 }
 
 //=============================================//
 void FloorRobot::add_single_model_to_planning_scene_(
-    std::string name, std::string mesh_file, geometry_msgs::msg::Pose model_pose)
+    const std::string &name, const std::string &mesh_file, const geometry_msgs::msg::Pose &model_pose)
+{
+    PlanningSceneBuilder builder;
+    if (stage_model_(builder, name, mesh_file, model_pose))
+        planning_scene_.addCollisionObjects(builder.collision_objects());
+}
+
+//=============================================//
+bool FloorRobot::flush_scene_(const PlanningSceneBuilder &builder)
 {
-    moveit_msgs::msg::CollisionObject collision;
+    if (builder.empty())
+        return true;
 
-    collision.id = name;
-    collision.header.frame_id = "world";
+    if (!planning_scene_.applyPlanningScene(builder.build()))
+    {
+        RCLCPP_ERROR_STREAM(get_logger(), "Unable to apply " << builder.size() << " changes to the planning scene");
+        return false;
+    }
 
-    shape_msgs::msg::Mesh mesh;
-    shapes::ShapeMsg mesh_msg;
+    return true;
+}
 
-    std::string package_share_directory = ament_index_cpp::get_package_share_directory("rwa67");
-    std::stringstream path;
-    path << "file://" << package_share_directory << "/meshes/" << mesh_file;
-    std::string model_path = path.str();
+//=============================================//
+std::string FloorRobot::add_scene_object_(
+    const std::string &kind, const std::string &mesh_file, const geometry_msgs::msg::Pose &pose)
+{
+    PlanningSceneBuilder builder;
+    auto id = scene_objects_.add(builder, kind, mesh_file, pose);
 
-    shapes::Mesh *m = shapes::createMeshFromResource(model_path);
-    shapes::constructMsgFromShape(m, mesh_msg);
+    if (id.empty())
+    {
+        RCLCPP_ERROR_STREAM(get_logger(), "Unknown mesh " << mesh_file << " for " << kind);
+        return id;
+    }
 
-    mesh = boost::get<shape_msgs::msg::Mesh>(mesh_msg);
+    // the object must be in the scene before it is attached
+    flush_scene_(builder);
+    return id;
+}
 
-    collision.meshes.push_back(mesh);
-    collision.mesh_poses.push_back(model_pose);
+//=============================================//
+void FloorRobot::attach_scene_object_(const std::string &id)
+{
+    if (id.empty())
+        return;
 
-    collision.operation = collision.ADD;
+    floor_robot_->attachObject(id);
+    scene_objects_.attach(id);
+    attached_object_id_ = id;
+}
 
-    std::vector<moveit_msgs::msg::CollisionObject> collision_objects;
-    collision_objects.push_back(collision);
+//=============================================//
+void FloorRobot::detach_scene_object_(const std::string &location)
+{
+    if (attached_object_id_.empty())
+        return;
 
-    planning_scene_.addCollisionObjects(collision_objects);
+    floor_robot_->detachObject(attached_object_id_);
+    scene_objects_.detach(attached_object_id_, location);
+    attached_object_id_.clear();
 }
 
 //=============================================//
-void FloorRobot::add_models_to_planning_scene_()
+void FloorRobot::collect_scene_objects_(const std::string &area)
+{
+    PlanningSceneBuilder builder;
+    if (scene_objects_.collect(builder, area) == 0)
+        return;
+
+    // may run in a subscription callback, the removal is not waited for
+    planning_scene_.addCollisionObjects(builder.collision_objects());
+    RCLCPP_INFO_STREAM(get_logger(), "Removed " << builder.size() << " objects of " << area
+                                                << " from the planning scene, " << scene_objects_.live_count() << " live objects");
+}
+
+//=============================================//
+void FloorRobot::stage_static_models_(PlanningSceneBuilder &builder)
 {
     // Add bins
     std::map<std::string, std::pair<double, double>> bin_positions = {
@@ -835,7 +1514,7 @@ void FloorRobot::add_models_to_planning_scene_()
         bin_pose.position.z = 0;
         bin_pose.orientation = Utils::get_quaternion_from_euler(0, 0, 3.14159);
 
-        add_single_model_to_planning_scene_(bin.first, "bin.stl", bin_pose);
+        stage_model_(builder, bin.first, "bin.stl", bin_pose);
     }
 
     // Add assembly stations
@@ -854,7 +1533,7 @@ void FloorRobot::add_models_to_planning_scene_()
         assembly_station_pose.position.z = 0;
         assembly_station_pose.orientation = Utils::get_quaternion_from_euler(0, 0, 0);
 
-        add_single_model_to_planning_scene_(station.first, "assembly_station.stl", assembly_station_pose);
+        stage_model_(builder, station.first, "assembly_station.stl", assembly_station_pose);
     }
 
     // Add assembly briefcases
@@ -873,7 +1552,7 @@ void FloorRobot::add_models_to_planning_scene_()
         assembly_insert_pose.position.z = 1.011;
         assembly_insert_pose.orientation = Utils::get_quaternion_from_euler(0, 0, 0);
 
-        add_single_model_to_planning_scene_(insert.first, "assembly_insert.stl", assembly_insert_pose);
+        stage_model_(builder, insert.first, "assembly_insert.stl", assembly_insert_pose);
     }
 
     geometry_msgs::msg::Pose conveyor_pose = geometry_msgs::msg::Pose();
@@ -882,7 +1561,7 @@ void FloorRobot::add_models_to_planning_scene_()
     conveyor_pose.position.z = 0;
     conveyor_pose.orientation = Utils::get_quaternion_from_euler(0, 0, 0);
 
-    add_single_model_to_planning_scene_("conveyor", "conveyor.stl", conveyor_pose);
+    stage_model_(builder, "conveyor", "conveyor.stl", conveyor_pose);
 
     geometry_msgs::msg::Pose kts1_table_pose;
     kts1_table_pose.position.x = -1.3;
@@ -890,7 +1569,7 @@ void FloorRobot::add_models_to_planning_scene_()
     kts1_table_pose.position.z = 0;
     kts1_table_pose.orientation = Utils::get_quaternion_from_euler(0, 0, 3.14159);
 
-    add_single_model_to_planning_scene_("kts1_table", "kit_tray_table.stl", kts1_table_pose);
+    stage_model_(builder, "kts1_table", "kit_tray_table.stl", kts1_table_pose);
 
     geometry_msgs::msg::Pose kts2_table_pose;
     kts2_table_pose.position.x = -1.3;
@@ -898,7 +1577,34 @@ void FloorRobot::add_models_to_planning_scene_()
     kts2_table_pose.position.z = 0;
     kts2_table_pose.orientation = Utils::get_quaternion_from_euler(0, 0, 0);
 
-    add_single_model_to_planning_scene_("kts2_table", "kit_tray_table.stl", kts2_table_pose);
+    stage_model_(builder, "kts2_table", "kit_tray_table.stl", kts2_table_pose);
+}
+
+//=============================================//
+void FloorRobot::add_models_to_planning_scene_()
+{
+    // the whole static environment is sent as one diff
+    PlanningSceneBuilder builder;
+    stage_static_models_(builder);
+
+    auto start = std::chrono::steady_clock::now();
+    bool applied = planning_scene_.applyPlanningScene(builder.build());
+    auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    if (applied)
+    {
+        RCLCPP_INFO_STREAM(get_logger(), "Added " << builder.size() << " static models to the planning scene in " << elapsed << " s");
+        trajectory_cache_->clear();
+    }
+    else
+    {
+        RCLCPP_ERROR_STREAM(get_logger(), "Failed to add the static models to the planning scene");
+
+        // none of them is in the scene
+        std::lock_guard<std::mutex> lock(scene_models_mutex_);
+        for (auto const &collision : builder.collision_objects())
+            scene_models_.erase(collision.id);
+    }
 }
 
 //=============================================//
@@ -918,74 +1624,746 @@ geometry_msgs::msg::Quaternion FloorRobot::set_robot_orientation_(double rotatio
 }
 
 //=============================================//
-bool FloorRobot::move_to_target_()
+void FloorRobot::add_roadmap_nodes_()
 {
-    moveit::planning_interface::MoveGroupInterface::Plan plan;
-    bool success = static_cast<bool>(floor_robot_->plan(plan));
+    auto joint_model_group = floor_robot_->getRobotModel()->getJointModelGroup(floor_robot_->getName());
+    auto const &variable_names = joint_model_group->getVariableNames();
 
-    if (success)
+    auto home_js = floor_robot_->getNamedTargetValues("home");
+
+    // Joint values in group order, joints missing from the map keep their home value
+    auto to_group_values = [&variable_names, &home_js](const std::map<std::string, double> &joint_values)
     {
-        return static_cast<bool>(floor_robot_->execute(plan));
-    }
-    else
+        std::vector<double> values;
+        for (auto const &name : variable_names)
+        {
+            auto it = joint_values.find(name);
+            values.push_back(it != joint_values.end() ? it->second : home_js[name]);
+        }
+        return values;
+    };
+
+    roadmap_->add_node("home", to_group_values(home_js));
+    roadmap_->add_node("kts1", to_group_values(floor_kts1_js_));
+    roadmap_->add_node("kts2", to_group_values(floor_kts2_js_));
+    roadmap_->add_node("drop_disposal", to_group_values(drop_disposal_js_));
+
+    // Rail stations are reached with the arm in its home posture, facing the bins and AGVs
+    for (auto const &rail_position : rail_positions_)
     {
-        RCLCPP_ERROR(get_logger(), "Unable to generate plan");
-        return false;
+        roadmap_->add_node(rail_position.first, to_group_values({{"linear_actuator_joint", rail_position.second},
+                                                                {"floor_shoulder_pan_joint", 0.0}}));
     }
 }
 
 //=============================================//
-bool FloorRobot::move_through_waypoints_(
-    std::vector<geometry_msgs::msg::Pose> waypoints, double vsf, double asf)
+void FloorRobot::build_roadmap_()
 {
-    moveit_msgs::msg::RobotTrajectory trajectory;
+    if (!motion_plan_client_->wait_for_service(std::chrono::seconds(10)))
+    {
+        RCLCPP_ERROR(get_logger(), "Planning service not available, roadmap not built");
+        return;
+    }
 
-    double path_fraction = floor_robot_->computeCartesianPath(waypoints, 0.01, 0.0, trajectory);
+    auto build_start = std::chrono::steady_clock::now();
+    auto base_state = floor_robot_->getCurrentState();
+    auto joint_model_group = base_state->getJointModelGroup(floor_robot_->getName());
+    auto node_names = roadmap_->node_names();
 
-    if (path_fraction < 0.9)
+    // the edges are retimed when used, so the edge back is the same path reversed
+    for (std::size_t i = 0; i < node_names.size(); i++)
     {
-        RCLCPP_ERROR(get_logger(), "Unable to generate trajectory through waypoints");
+        for (std::size_t j = i + 1; j < node_names.size(); j++)
+        {
+            auto const &from = node_names[i];
+            auto const &to = node_names[j];
+            if (shutting_down_)
+                return;
+
+            std::vector<double> from_values, to_values;
+            roadmap_->get_node(from, from_values);
+            roadmap_->get_node(to, to_values);
+
+            moveit::core::RobotState start_state(*base_state);
+            start_state.setJointGroupPositions(joint_model_group, from_values);
+            start_state.update();
+
+            moveit::core::RobotState goal_state(start_state);
+            goal_state.setJointGroupPositions(joint_model_group, to_values);
+            goal_state.update();
+
+            auto request = std::make_shared<moveit_msgs::srv::GetMotionPlan::Request>();
+            auto &plan_request = request->motion_plan_request;
+            plan_request.group_name = floor_robot_->getName();
+            plan_request.num_planning_attempts = 5;
+            plan_request.allowed_planning_time = 5.0;
+            plan_request.max_velocity_scaling_factor = 1.0;
+            plan_request.max_acceleration_scaling_factor = 1.0;
+            moveit::core::robotStateToRobotStateMsg(start_state, plan_request.start_state);
+            plan_request.goal_constraints.push_back(
+                kinematic_constraints::constructGoalConstraints(goal_state, joint_model_group));
+
+            auto result = motion_plan_client_->async_send_request(request);
+            if (result.wait_for(std::chrono::seconds(10)) != std::future_status::ready)
+            {
+                RCLCPP_WARN_STREAM(get_logger(), "Roadmap edge " << from << " -> " << to << " timed out");
+                continue;
+            }
+
+            auto response = result.get();
+            if (response->motion_plan_response.error_code.val != moveit_msgs::msg::MoveItErrorCodes::SUCCESS)
+            {
+                RCLCPP_WARN_STREAM(get_logger(), "Unable to plan roadmap edge " << from << " -> " << to);
+                continue;
+            }
+
+            robot_trajectory::RobotTrajectory path(base_state->getRobotModel(), floor_robot_->getName());
+            path.setRobotTrajectoryMsg(start_state, response->motion_plan_response.trajectory);
+            roadmap_->set_edge(from, to, response->motion_plan_response.trajectory);
+
+            moveit_msgs::msg::RobotTrajectory reversed;
+            path.reverse();
+            path.getRobotTrajectoryMsg(reversed);
+            roadmap_->set_edge(to, from, reversed);
+        }
+    }
+
+    std::chrono::duration<double> build_time = std::chrono::steady_clock::now() - build_start;
+    RCLCPP_INFO_STREAM(get_logger(), "Roadmap built: " << node_names.size() << " nodes, "
+                                                       << roadmap_->edge_count() << " edges in " << build_time.count() << " s");
+}
+
+//=============================================//
+bool FloorRobot::plan_along_roadmap_(moveit::planning_interface::MoveGroupInterface &group, const moveit::core::RobotState &start_state,
+                                     moveit_msgs::msg::RobotTrajectory &trajectory)
+{
+    auto joint_model_group = start_state.getJointModelGroup(group.getName());
+
+    std::vector<double> start_values, target_values;
+    start_state.copyJointGroupPositions(joint_model_group, start_values);
+    group.getJointValueTarget().copyJointGroupPositions(joint_model_group, target_values);
+
+    auto from = roadmap_->nearest_node(start_values);
+    auto to = roadmap_->nearest_node(target_values);
+    if (from.empty() || to.empty() || from == to)
+        return false;
+
+    moveit_msgs::msg::RobotTrajectory edge;
+    if (!roadmap_->get_edge(from, to, edge))
+        return false;
+
+    // Start and end exactly at the current state and the target instead of the nodes
+    robot_trajectory::RobotTrajectory rt(start_state.getRobotModel(), group.getName());
+    rt.setRobotTrajectoryMsg(start_state, edge);
+    if (rt.getWayPointCount() < 2)
+        return false;
+
+    rt.getFirstWayPointPtr()->setJointGroupPositions(joint_model_group, start_values);
+    rt.getLastWayPointPtr()->setJointGroupPositions(joint_model_group, target_values);
+    rt.getFirstWayPointPtr()->update();
+    rt.getLastWayPointPtr()->update();
+
+    auto profile = motion_profiles_.profile(MotionClass::FREE_TRANSIT);
+    if (!totg_.computeTimeStamps(rt, profile.vsf, profile.asf))
+        return false;
+    rt.getRobotTrajectoryMsg(trajectory);
+
+    // The edge was planned with an empty gripper and without the trays and parts, check it in the current scene
+    if (!is_trajectory_valid_(trajectory, start_state, roadmap_tolerance_))
+    {
+        RCLCPP_WARN_STREAM(get_logger(), "Roadmap edge " << from << " -> " << to << " is not valid in the current scene");
         return false;
     }
 
+    RCLCPP_INFO_STREAM(get_logger(), "Using roadmap edge " << from << " -> " << to);
+    return true;
+}
+
+//=============================================//
+bool FloorRobot::plan_to_target_(moveit::planning_interface::MoveGroupInterface &group, const moveit::core::RobotState &start_state,
+                                 PlannedMotion &motion)
+{
+    reset_motion_(motion);
+    auto planning_start = std::chrono::steady_clock::now();
+
+    auto profile = motion_profiles_.profile(MotionClass::FREE_TRANSIT);
+    group.setMaxVelocityScalingFactor(profile.vsf);
+    group.setMaxAccelerationScalingFactor(profile.asf);
+
+    // Shuttles between canonical configurations do not need a new plan
+    if (!(use_roadmap_ && plan_along_roadmap_(group, start_state, motion.trajectory)))
+    {
+        group.setStartState(start_state);
+        auto &plan = workspace_().plan;
+        bool success = static_cast<bool>(group.plan(plan));
+        group.setStartStateToCurrentState();
+        motion.trajectory = plan.trajectory_;
+
+        if (!success)
+        {
+            RCLCPP_ERROR(get_logger(), "Unable to generate plan");
+            return false;
+        }
+    }
+
+    std::chrono::duration<double> planning_time = std::chrono::steady_clock::now() - planning_start;
+    motion.planning_time = planning_time.count();
+    return true;
+}
+
+//=============================================//
+bool FloorRobot::plan_vertical_move_(const std::vector<geometry_msgs::msg::Pose> &waypoints,
+                                     const moveit::core::RobotState &start_state, moveit_msgs::msg::RobotTrajectory &trajectory)
+{
+    VerticalMoveGenerator::Result result;
+    if (!vertical_move_generator_->generate(start_state, waypoints, result))
+    {
+        if (result.ik_calls > 0)
+            RCLCPP_DEBUG(get_logger(), "Vertical move generator failed, using computeCartesianPath");
+        return false;
+    }
+
+    auto joint_model_group = start_state.getJointModelGroup(floor_robot_->getName());
+    robot_trajectory::RobotTrajectory rt(start_state.getRobotModel(), floor_robot_->getName());
+    {
+        // the samples are checked with the object held by the gripper
+        planning_scene_monitor::LockedPlanningSceneRO scene(planning_scene_monitor_);
+        auto sample_state = scene_state_(scene, start_state);
+        for (auto const &joint_values : result.path)
+        {
+            sample_state.setJointGroupPositions(joint_model_group, joint_values);
+            sample_state.update();
+            rt.addSuffixWayPoint(sample_state, 0.0);
+        }
+
+        if (!scene->isPathValid(rt, floor_robot_->getName()))
+        {
+            RCLCPP_DEBUG(get_logger(), "Vertical move is in collision, using computeCartesianPath");
+            return false;
+        }
+    }
+
+    RCLCPP_DEBUG_STREAM(get_logger(), "Vertical move: " << result.path.size() << " samples, "
+                                                        << result.ik_calls << " IK calls, "
+                                                        << result.interpolated_samples << " interpolated");
+    rt.getRobotTrajectoryMsg(trajectory);
+    return true;
+}
+
+//=============================================//
+bool FloorRobot::plan_through_waypoints_(
+    moveit::planning_interface::MoveGroupInterface &group, const std::vector<geometry_msgs::msg::Pose> &waypoints,
+    double vsf, double asf, const moveit::core::RobotState &start_state, PlannedMotion &motion, bool use_cache)
+{
+    reset_motion_(motion);
+
+    // Reuse a stored trajectory if the same motion was already planned from this state
+    if (use_trajectory_cache_ && use_cache)
+    {
+        auto &joint_values = workspace_().joint_values;
+        start_state.copyJointGroupPositions(group.getName(), joint_values);
+        trajectory_cache_->make_key(joint_values, waypoints, vsf, asf, motion.cache_key);
+
+        if (trajectory_cache_->lookup(motion.cache_key, motion.trajectory))
+        {
+            if (is_trajectory_valid_(motion.trajectory, start_state, trajectory_cache_start_tolerance_))
+            {
+                RCLCPP_DEBUG(get_logger(), "Replaying cached trajectory");
+                motion.from_cache = true;
+                return true;
+            }
+
+            RCLCPP_WARN(get_logger(), "Cached trajectory is no longer valid, replanning");
+            trajectory_cache_->reject(motion.cache_key);
+        }
+    }
+
+    auto planning_start = std::chrono::steady_clock::now();
+
+    // Straight up or down moves do not need an IK call per centimeter
+    if (!(use_vertical_moves_ && plan_vertical_move_(waypoints, start_state, motion.trajectory)))
+    {
+        group.setStartState(start_state);
+        double path_fraction = group.computeCartesianPath(waypoints, 0.01, 0.0, motion.trajectory);
+        group.setStartStateToCurrentState();
+
+        if (path_fraction < 0.9)
+        {
+            RCLCPP_ERROR(get_logger(), "Unable to generate trajectory through waypoints");
+            return false;
+        }
+    }
+
     // Retime trajectory
-    robot_trajectory::RobotTrajectory rt(floor_robot_->getCurrentState()->getRobotModel(), "floor_robot");
-    rt.setRobotTrajectoryMsg(*floor_robot_->getCurrentState(), trajectory);
+    auto &rt = *workspace_().retime_trajectory;
+    rt.setRobotTrajectoryMsg(start_state, motion.trajectory);
     totg_.computeTimeStamps(rt, vsf, asf);
-    rt.getRobotTrajectoryMsg(trajectory);
+    rt.getRobotTrajectoryMsg(motion.trajectory);
 
-    return static_cast<bool>(floor_robot_->execute(trajectory));
+    std::chrono::duration<double> planning_time = std::chrono::steady_clock::now() - planning_start;
+    motion.planning_time = planning_time.count();
+    return true;
 }
 
 //=============================================//
-void FloorRobot::wait_for_attach_completion_(double timeout, double dz)
+bool FloorRobot::plan_segment_(moveit::planning_interface::MoveGroupInterface &group, const MotionSegment &segment,
+                               const moveit::core::RobotState &start_state, PlannedMotion &motion)
 {
-    // Wait for part to be attached
-    rclcpp::Time start = now();
-    std::vector<geometry_msgs::msg::Pose> waypoints;
-    geometry_msgs::msg::Pose starting_pose = floor_robot_->getCurrentPose().pose;
+    if (segment.waypoints.empty())
+    {
+        for (auto const &joint : segment.joint_target)
+            group.setJointValueTarget(joint.first, joint.second);
+
+        return plan_to_target_(group, start_state, motion);
+    }
+
+    auto profile = motion_profiles_.profile(segment.motion_class);
+    if (!plan_through_waypoints_(group, segment.waypoints, profile.vsf, profile.asf, start_state, motion))
+        return false;
+
+    motion.motion_class = segment.motion_class;
+    return true;
+}
+
+//=============================================//
+bool FloorRobot::execute_planned_motion_(const PlannedMotion &motion)
+{
+    bool attached = floor_gripper_state_.snapshot()->attached;
+    bool success = static_cast<bool>(floor_robot_->execute(motion.trajectory));
 
-    while (!floor_gripper_state_.attached)
+    // Only trajectories that executed successfully are worth replaying
+    if (success && use_trajectory_cache_ && !motion.from_cache && !motion.cache_key.empty())
+        trajectory_cache_->insert(motion.cache_key, motion.trajectory, motion.planning_time);
+
+    // An object held at the start must not be dropped on the way
+    record_motion_outcome_(motion.motion_class, success && (!attached || floor_gripper_state_.snapshot()->attached), motion.trajectory);
+
+    return success;
+}
+
+//=============================================//
+bool FloorRobot::execute_motion_pipeline_(const std::vector<MotionSegment> &segments)
+{
+    if (segments.empty())
+        return true;
+
+    auto current_state = floor_robot_->getCurrentState();
+
+    PlannedMotion current;
+    if (!plan_segment_(*floor_robot_, segments.front(), *current_state, current))
     {
-        RCLCPP_INFO_THROTTLE(get_logger(), *get_clock(), 1000, "Waiting for gripper attach");
+        RCLCPP_ERROR_STREAM(get_logger(), "Unable to plan segment " << segments.front().name);
+        return false;
+    }
 
-        waypoints.clear();
-        starting_pose.position.z -= dz;
-        waypoints.push_back(starting_pose);
+    for (std::size_t i = 0; i < segments.size(); i++)
+    {
+        auto predicted_end = trajectory_end_state_(current.trajectory, *current_state);
 
-        move_through_waypoints_(waypoints, 0.1, 0.1);
+        // Execute segment i while segment i+1 is planned from its predicted end state
+        auto execution_start = std::chrono::steady_clock::now();
+        auto execution = std::async(std::launch::async, [this, &current]()
+                                    { return execute_planned_motion_(current); });
 
-        usleep(200);
+        PlannedMotion next;
+        bool next_planned = false;
+        if (i + 1 < segments.size())
+            next_planned = plan_segment_(*lookahead_robot_, segments[i + 1], predicted_end, next);
+        std::chrono::duration<double> lookahead_time = std::chrono::steady_clock::now() - execution_start;
 
-        // if (floor_gripper_state_.attached)
-        //     return;
+        bool executed = execution.get();
+        std::chrono::duration<double> execution_time = std::chrono::steady_clock::now() - execution_start;
 
-         if (now() - start > rclcpp::Duration::from_seconds(timeout))
+        RCLCPP_INFO_STREAM(get_logger(), "Segment " << segments[i].name << ": planned in " << current.planning_time
+                                                    << " s, executed in " << execution_time.count() << " s"
+                                                    << (i + 1 < segments.size() ? ", next segment planned in " + std::to_string(lookahead_time.count()) + " s during execution" : ""));
+
+        if (!executed)
         {
-            RCLCPP_ERROR(get_logger(), "Unable to pick up object");
-            return;
+            RCLCPP_ERROR_STREAM(get_logger(), "Unable to execute segment " << segments[i].name);
+            return false;
+        }
+
+        if (i + 1 == segments.size())
+            break;
+
+        // Commit the lookahead plan only if the robot stopped where it was predicted to
+        current_state = floor_robot_->getCurrentState();
+        if (!next_planned || joint_distance_(*current_state, predicted_end) > pipeline_commit_tolerance_)
+        {
+            RCLCPP_WARN_STREAM(get_logger(), "Replanning segment " << segments[i + 1].name << " from the actual end state");
+            if (!plan_segment_(*floor_robot_, segments[i + 1], *current_state, next))
+            {
+                RCLCPP_ERROR_STREAM(get_logger(), "Unable to plan segment " << segments[i + 1].name);
+                return false;
+            }
+        }
+
+        current = next;
+    }
+
+    return true;
+}
+
+//=============================================//
+bool FloorRobot::move_transit_and_approach_(const MotionSegment &transit, const MotionSegment &approach)
+{
+    if (use_blending_)
+    {
+        if (move_blended_(transit, approach))
+            return true;
+
+        RCLCPP_WARN_STREAM(get_logger(), "Unable to blend " << transit.name << " and " << approach.name << ", moving segment by segment");
+    }
+
+    return execute_motion_pipeline_({transit, approach});
+}
+
+//=============================================//
+bool FloorRobot::move_blended_(const MotionSegment &transit, const MotionSegment &approach)
+{
+    auto planning_start = std::chrono::steady_clock::now();
+    auto start_state = floor_robot_->getCurrentState();
+    auto joint_model_group = start_state->getJointModelGroup(floor_robot_->getName());
+
+    // Joint-space transit
+    PlannedMotion transit_motion;
+    if (!plan_segment_(*floor_robot_, transit, *start_state, transit_motion))
+        return false;
+    auto junction_state = trajectory_end_state_(transit_motion.trajectory, *start_state);
+
+    // Cartesian approach from the end of the transit, not retimed yet
+    moveit_msgs::msg::RobotTrajectory approach_path;
+    floor_robot_->setStartState(junction_state);
+    double path_fraction = floor_robot_->computeCartesianPath(approach.waypoints, 0.01, 0.0, approach_path);
+    floor_robot_->setStartStateToCurrentState();
+    if (path_fraction < 0.9)
+        return false;
+
+    // Join both paths, dropping the timing and the duplicated junction point
+    robot_trajectory::RobotTrajectory transit_rt(start_state->getRobotModel(), floor_robot_->getName());
+    transit_rt.setRobotTrajectoryMsg(*start_state, transit_motion.trajectory);
+    robot_trajectory::RobotTrajectory approach_rt(start_state->getRobotModel(), floor_robot_->getName());
+    approach_rt.setRobotTrajectoryMsg(junction_state, approach_path);
+
+    robot_trajectory::RobotTrajectory rt(start_state->getRobotModel(), floor_robot_->getName());
+    for (std::size_t i = 0; i < transit_rt.getWayPointCount(); i++)
+        rt.addSuffixWayPoint(transit_rt.getWayPoint(i), 0.0);
+    for (std::size_t i = 1; i < approach_rt.getWayPointCount(); i++)
+        rt.addSuffixWayPoint(approach_rt.getWayPoint(i), 0.0);
+
+    // TOTG rounds each corner of the joint path, but its arc starts at most halfway along the adjacent segments.
+    // At the junction the adjacent segment is the first 1 cm Cartesian step, so the corner deviates by a few
+    // millimeters at most: the arm keeps moving through the junction because of the time warp below, not
+    // because of a wide blend. blend_path_tolerance_ only bounds the deviation at the corners of the transit.
+    auto transit_profile = motion_profiles_.profile(MotionClass::FREE_TRANSIT);
+    trajectory_processing::TimeOptimalTrajectoryGeneration blend_totg(blend_path_tolerance_);
+    if (!blend_totg.computeTimeStamps(rt, transit_profile.vsf, transit_profile.asf))
+        return false;
+
+    // The transit runs with the free transit profile. Slow down to the approach scaling before the junction by
+    // warping time: scaling the speed along the path by sigma scales the velocities by sigma and the accelerations
+    // by sigma^2.
+    std::size_t junction_index = 0;
+    double junction_distance = std::numeric_limits<double>::infinity();
+    for (std::size_t i = 0; i < rt.getWayPointCount(); i++)
+    {
+        double distance = joint_distance_(rt.getWayPoint(i), junction_state);
+        if (distance < junction_distance)
+        {
+            junction_distance = distance;
+            junction_index = i;
+        }
+    }
+
+    auto approach_profile = motion_profiles_.profile(approach.motion_class);
+    double approach_sigma = std::min(1.0, std::min(approach_profile.vsf / transit_profile.vsf,
+                                                   std::sqrt(approach_profile.asf / transit_profile.asf)));
+    double junction_time = rt.getWayPointDurationFromStart(junction_index);
+    auto sigma_at = [&](double t)
+    {
+        if (t >= junction_time)
+            return approach_sigma;
+        if (t <= junction_time - blend_ramp_time_)
+            return 1.0;
+        // smooth ramp from 1 to approach_sigma
+        double ratio = (t - (junction_time - blend_ramp_time_)) / blend_ramp_time_;
+        return 1.0 + (approach_sigma - 1.0) * 0.5 * (1.0 - std::cos(M_PI * ratio));
+    };
+
+    std::vector<double> sigmas;
+    for (std::size_t i = 0; i < rt.getWayPointCount(); i++)
+        sigmas.push_back(sigma_at(rt.getWayPointDurationFromStart(i)));
+
+    auto const &variable_indices = joint_model_group->getVariableIndexList();
+    for (std::size_t i = 0; i < rt.getWayPointCount(); i++)
+    {
+        if (i > 0)
+            rt.setWayPointDurationFromPrevious(i, rt.getWayPointDurationFromPrevious(i) * 2.0 / (sigmas[i - 1] + sigmas[i]));
+
+        auto waypoint = rt.getWayPointPtr(i);
+        for (auto index : variable_indices)
+            waypoint->setVariableVelocity(index, waypoint->getVariableVelocity(index) * sigmas[i]);
+    }
+
+    // Accelerations from the warped velocities
+    for (std::size_t i = 0; i < rt.getWayPointCount(); i++)
+    {
+        auto waypoint = rt.getWayPointPtr(i);
+        std::size_t previous = i > 0 ? i - 1 : i;
+        std::size_t next = i + 1 < rt.getWayPointCount() ? i + 1 : i;
+        double dt = rt.getWayPointDurationFromStart(next) - rt.getWayPointDurationFromStart(previous);
+        for (auto index : variable_indices)
+        {
+            double dv = rt.getWayPoint(next).getVariableVelocity(index) - rt.getWayPoint(previous).getVariableVelocity(index);
+            waypoint->setVariableAcceleration(index, dt > 0.0 ? dv / dt : 0.0);
+        }
+    }
+
+    // TOTG only bounded the unwarped trajectory, check the limits again, 1% margin for the finite differences
+    auto robot_model = start_state->getRobotModel();
+    for (std::size_t i = 0; i < rt.getWayPointCount(); i++)
+    {
+        for (auto index : variable_indices)
+        {
+            auto const &bounds = robot_model->getVariableBounds(robot_model->getVariableNames()[index]);
+            double velocity = std::fabs(rt.getWayPoint(i).getVariableVelocity(index));
+            double acceleration = std::fabs(rt.getWayPoint(i).getVariableAcceleration(index));
+            if ((bounds.velocity_bounded_ && velocity > 1.01 * bounds.max_velocity_) ||
+                (bounds.acceleration_bounded_ && acceleration > 1.01 * bounds.max_acceleration_))
+            {
+                RCLCPP_WARN_STREAM(get_logger(), "Blended trajectory exceeds the limits of "
+                                                     << robot_model->getVariableNames()[index]);
+                return false;
+            }
         }
     }
+
+    moveit_msgs::msg::RobotTrajectory trajectory;
+    rt.getRobotTrajectoryMsg(trajectory);
+
+    // Blended corners leave the planned paths, check the result
+    if (!is_trajectory_valid_(trajectory, *start_state, blend_start_tolerance_))
+    {
+        RCLCPP_WARN(get_logger(), "Blended trajectory is in collision");
+        return false;
+    }
+
+    std::chrono::duration<double> planning_time = std::chrono::steady_clock::now() - planning_start;
+    RCLCPP_INFO_STREAM(get_logger(), "Blended " << transit.name << " and " << approach.name << " in " << planning_time.count()
+                                                << " s, duration " << rt.getDuration() << " s");
+
+    bool attached = floor_gripper_state_.snapshot()->attached;
+    bool success = static_cast<bool>(floor_robot_->execute(trajectory));
+    record_motion_outcome_(approach.motion_class, success && (!attached || floor_gripper_state_.snapshot()->attached), trajectory);
+    return success;
+}
+
+//=============================================//
+moveit::core::RobotState FloorRobot::trajectory_end_state_(
+    const moveit_msgs::msg::RobotTrajectory &trajectory, const moveit::core::RobotState &reference_state)
+{
+    robot_trajectory::RobotTrajectory rt(reference_state.getRobotModel(), floor_robot_->getName());
+    rt.setRobotTrajectoryMsg(reference_state, trajectory);
+
+    if (rt.empty())
+        return reference_state;
+
+    return rt.getLastWayPoint();
+}
+
+//=============================================//
+double FloorRobot::joint_distance_(const moveit::core::RobotState &state1, const moveit::core::RobotState &state2)
+{
+    auto joint_model_group = state1.getJointModelGroup(floor_robot_->getName());
+
+    std::vector<double> values1, values2;
+    state1.copyJointGroupPositions(joint_model_group, values1);
+    state2.copyJointGroupPositions(joint_model_group, values2);
+
+    double max_difference = 0.0;
+    for (std::size_t i = 0; i < values1.size(); i++)
+        max_difference = std::max(max_difference, std::fabs(values1[i] - values2[i]));
+
+    return max_difference;
+}
+
+//=============================================//
+bool FloorRobot::move_to_target_()
+{
+    allocation_counter::Scope allocations;
+
+    auto &motion = workspace_().motion;
+    bool success = plan_to_target_(*floor_robot_, refresh_current_state_(), motion) &&
+                   execute_planned_motion_(motion);
+
+    std::lock_guard<std::mutex> lock(allocations_mutex_);
+    move_to_target_allocations_.add(allocations.allocations());
+    return success;
+}
+
+//=============================================//
+bool FloorRobot::move_through_waypoints_(
+    const std::vector<geometry_msgs::msg::Pose> &waypoints, MotionClass motion_class)
+{
+    allocation_counter::Scope allocations;
+
+    auto profile = motion_profiles_.profile(motion_class);
+    auto &motion = workspace_().motion;
+    bool success = plan_through_waypoints_(*floor_robot_, waypoints, profile.vsf, profile.asf, refresh_current_state_(), motion);
+    if (success)
+    {
+        motion.motion_class = motion_class;
+        success = execute_planned_motion_(motion);
+    }
+
+    std::lock_guard<std::mutex> lock(allocations_mutex_);
+    move_through_waypoints_allocations_.add(allocations.allocations());
+    return success;
+}
+
+//=============================================//
+FloorRobot::MotionWorkspace &FloorRobot::workspace_()
+{
+    std::lock_guard<std::mutex> lock(workspaces_mutex_);
+
+    auto &workspace = workspaces_[std::this_thread::get_id()];
+    if (!workspace)
+    {
+        workspace = std::make_unique<MotionWorkspace>();
+        workspace->current_state = std::make_shared<moveit::core::RobotState>(floor_robot_->getRobotModel());
+        workspace->current_state->setToDefaultValues();
+        workspace->retime_trajectory = std::make_shared<robot_trajectory::RobotTrajectory>(
+            floor_robot_->getRobotModel(), floor_robot_->getName());
+    }
+
+    return *workspace;
+}
+
+//=============================================//
+const moveit::core::RobotState &FloorRobot::refresh_current_state_()
+{
+    auto &current_state = *workspace_().current_state;
+
+    auto state_monitor = planning_scene_monitor_->getStateMonitor();
+    if (state_monitor && state_monitor->haveCompleteState())
+        state_monitor->setToCurrentState(current_state);
+    else
+        current_state = *floor_robot_->getCurrentState();
+
+    current_state.update();
+    return current_state;
+}
+
+//=============================================//
+void FloorRobot::reset_motion_(PlannedMotion &motion)
+{
+    // clear() keeps the capacity of the buffers
+    motion.trajectory.joint_trajectory.points.clear();
+    motion.trajectory.multi_dof_joint_trajectory.points.clear();
+    motion.cache_key.clear();
+    motion.from_cache = false;
+    motion.planning_time = 0.0;
+    motion.motion_class = MotionClass::FREE_TRANSIT;
+}
+
+//=============================================//
+bool FloorRobot::is_trajectory_valid_(
+    const moveit_msgs::msg::RobotTrajectory &trajectory, const moveit::core::RobotState &start_state,
+    double start_tolerance)
+{
+    planning_scene_monitor::LockedPlanningSceneRO scene(planning_scene_monitor_);
+
+    // the waypoints are checked with the objects held by the gripper
+    robot_trajectory::RobotTrajectory rt(start_state.getRobotModel(), floor_robot_->getName());
+    rt.setRobotTrajectoryMsg(scene_state_(scene, start_state), trajectory);
+
+    if (rt.empty())
+        return false;
+
+    // The trajectory must start where the robot currently is
+    if (joint_distance_(rt.getFirstWayPoint(), start_state) > start_tolerance)
+        return false;
+
+    return scene->isPathValid(rt, floor_robot_->getName());
+}
+
+//=============================================//
+moveit::core::RobotState FloorRobot::scene_state_(const planning_scene_monitor::LockedPlanningSceneRO &scene,
+                                                  const moveit::core::RobotState &state)
+{
+    moveit::core::RobotState scene_state(scene->getCurrentState());
+    scene_state.setVariablePositions(state.getVariablePositions());
+    scene_state.update();
+    return scene_state;
+}
+
+//=============================================//
+void FloorRobot::wait_for_attach_completion_(double timeout, MotionClass descent_class)
+{
+    if (floor_gripper_state_.snapshot()->attached)
+        return;
+
+    // Move down until the object is attached, at most for timeout seconds
+    auto profile = motion_profiles_.profile(descent_class);
+    double descent_speed = profile.max_speed > 0.0 ? profile.max_speed : 0.01;
+    double depth = std::min(grasp_descent_max_depth_, descent_speed * timeout);
+    geometry_msgs::msg::Pose target_pose = floor_robot_->getCurrentPose().pose;
+    target_pose.position.z -= depth;
+
+    // the descent is stretched and stopped on attach, it is neither counted nor stored by the cache
+    PlannedMotion motion;
+    if (!plan_through_waypoints_(*floor_robot_, {target_pose}, profile.vsf, profile.asf, *floor_robot_->getCurrentState(),
+                                 motion, false))
+    {
+        RCLCPP_ERROR(get_logger(), "Unable to plan the grasp descent");
+        return;
+    }
+    stretch_trajectory_(motion.trajectory, depth / descent_speed);
+
+    RCLCPP_INFO(get_logger(), "Waiting for gripper attach");
+    auto descent_start = std::chrono::steady_clock::now();
+
+    // FloorRobot::floor_gripper_state_cb stops the execution on attach. The flag is raised before
+    // checking the gripper again: an attach published while planning would not stop anything.
+    grasp_descent_active_ = true;
+    if (!floor_gripper_state_.snapshot()->attached)
+        floor_robot_->execute(motion.trajectory);
+    grasp_descent_active_ = false;
+
+    // the attach event may arrive just after the end of the descent
+    bool attached = floor_gripper_state_.wait_until_attached(0.2);
+    record_motion_outcome_(descent_class, attached, motion.trajectory);
+    if (!attached)
+    {
+        RCLCPP_ERROR(get_logger(), "Unable to pick up object");
+        return;
+    }
+
+    std::chrono::duration<double> descent_time = std::chrono::steady_clock::now() - descent_start;
+    RCLCPP_INFO_STREAM(get_logger(), "Object attached after " << descent_time.count() << " s");
+}
+
+//=============================================//
+void FloorRobot::stretch_trajectory_(moveit_msgs::msg::RobotTrajectory &trajectory, double duration)
+{
+    auto &points = trajectory.joint_trajectory.points;
+    if (points.empty())
+        return;
+
+    double current_duration = rclcpp::Duration(points.back().time_from_start).seconds();
+    if (current_duration <= 0.0 || current_duration >= duration)
+        return;
+
+    double k = duration / current_duration;
+    for (auto &point : points)
+    {
+        point.time_from_start = rclcpp::Duration::from_seconds(rclcpp::Duration(point.time_from_start).seconds() * k);
+        for (auto &velocity : point.velocities)
+            velocity /= k;
+        for (auto &acceleration : point.accelerations)
+            acceleration /= k * k;
+    }
 }
 
 //=============================================//
@@ -999,9 +2377,9 @@ bool FloorRobot::go_home_()
 //=============================================//
 bool FloorRobot::set_gripper_state_(bool enable)
 {
-    if (floor_gripper_state_.enabled == enable)
+    if (floor_gripper_state_.snapshot()->enabled == enable)
     {
-        if (floor_gripper_state_.enabled)
+        if (enable)
             RCLCPP_INFO(get_logger(), "Already enabled");
         else
             RCLCPP_INFO(get_logger(), "Already disabled");
@@ -1022,6 +2400,10 @@ bool FloorRobot::set_gripper_state_(bool enable)
         return false;
     }
 
+    // Wait for the gripper to report the new state (and release the object when disabled)
+    if (!floor_gripper_state_.wait_until_enabled(enable, 1.0))
+        RCLCPP_WARN(get_logger(), "Gripper state not updated after calling the gripper enable service");
+
     return true;
 }
 
@@ -1029,7 +2411,9 @@ bool FloorRobot::set_gripper_state_(bool enable)
 bool FloorRobot::change_gripper_(std::string changing_station, std::string gripper_type)
 {
     // Move gripper into tool changer
-    auto tc_pose = get_pose_in_world_frame_(changing_station + "_tool_changer_" + gripper_type + "_frame");
+    geometry_msgs::msg::Pose tc_pose;
+    if (!get_pose_in_world_frame_(changing_station + "_tool_changer_" + gripper_type + "_frame", tc_pose))
+        return false;
 
     std::vector<geometry_msgs::msg::Pose> waypoints;
     waypoints.push_back(Utils::build_pose(tc_pose.position.x, tc_pose.position.y,
@@ -1038,7 +2422,7 @@ bool FloorRobot::change_gripper_(std::string changing_station, std::string gripp
     waypoints.push_back(Utils::build_pose(tc_pose.position.x, tc_pose.position.y,
                                           tc_pose.position.z, set_robot_orientation_(0.0)));
 
-    if (!move_through_waypoints_(waypoints, 0.2, 0.1))
+    if (!move_through_waypoints_(waypoints, MotionClass::TOOL_CHANGE))
         return false;
 
     // Call service to change gripper
@@ -1066,7 +2450,7 @@ bool FloorRobot::change_gripper_(std::string changing_station, std::string gripp
     waypoints.push_back(Utils::build_pose(tc_pose.position.x, tc_pose.position.y,
                                           tc_pose.position.z + 0.4, set_robot_orientation_(0.0)));
 
-    if (!move_through_waypoints_(waypoints, 0.2, 0.1))
+    if (!move_through_waypoints_(waypoints, MotionClass::TOOL_CHANGE))
         return false;
 
     return true;
@@ -1083,20 +2467,22 @@ bool FloorRobot::place_tray_(int tray_id, int agv_num)
 
     double tray_rotation = Utils::get_yaw_from_pose_(tray_pose);
 
-    std::string tray_name = "kit_tray_" + std::to_string(tray_id);
+    (void)tray_id; // the attached tray is tracked by the scene object manager
 
     // Move up slightly
     waypoints.clear();
     waypoints.push_back(Utils::build_pose(tray_pose.position.x, tray_pose.position.y,
                                           tray_pose.position.z + 0.2, set_robot_orientation_(tray_rotation)));
-    move_through_waypoints_(waypoints, 0.3, 0.3);
+    move_through_waypoints_(waypoints, MotionClass::LIFT);
 
     floor_robot_->setJointValueTarget("linear_actuator_joint", rail_positions_["agv" + std::to_string(agv_num)]);
     floor_robot_->setJointValueTarget("floor_shoulder_pan_joint", 0);
 
     move_to_target_();
 
-    auto agv_tray_pose = get_pose_in_world_frame_("agv" + std::to_string(agv_num) + "_tray");
+    geometry_msgs::msg::Pose agv_tray_pose;
+    if (!get_pose_in_world_frame_("agv" + std::to_string(agv_num) + "_tray", agv_tray_pose))
+        return false;
     auto agv_rotation = Utils::get_yaw_from_pose_(agv_tray_pose);
 
     waypoints.clear();
@@ -1106,12 +2492,12 @@ bool FloorRobot::place_tray_(int tray_id, int agv_num)
     waypoints.push_back(Utils::build_pose(agv_tray_pose.position.x, agv_tray_pose.position.y,
                                           agv_tray_pose.position.z + kit_tray_thickness_ + drop_height_, set_robot_orientation_(agv_rotation)));
 
-    move_through_waypoints_(waypoints, 0.2, 0.1);
+    move_through_waypoints_(waypoints, MotionClass::APPROACH_WITH_TRAY);
 
     set_gripper_state_(false);
 
     // object is detached in the planning scene
-    floor_robot_->detachObject(tray_name);
+    detach_scene_object_("agv" + std::to_string(agv_num));
 
     // publish to robot state
     // lock_tray_(agv_num);
@@ -1120,56 +2506,85 @@ bool FloorRobot::place_tray_(int tray_id, int agv_num)
     waypoints.push_back(Utils::build_pose(agv_tray_pose.position.x, agv_tray_pose.position.y,
                                           agv_tray_pose.position.z + 0.3, set_robot_orientation_(0)));
 
-    move_through_waypoints_(waypoints, 0.2, 0.1);
+    move_through_waypoints_(waypoints, MotionClass::RETREAT);
 
     return true;
 }
 
 //=============================================//
-bool FloorRobot::pick_bin_part_(ariac_msgs::msg::Part part_to_pick)
+bool FloorRobot::pick_and_place_tray_(int tray_id, int agv_num)
 {
-    RCLCPP_INFO_STREAM(get_logger(), "Attempting to pick a " << part_colors_[part_to_pick.color] << " " << part_types_[part_to_pick.type]);
-
-    // Check if part is in one of the bins
-    geometry_msgs::msg::Pose part_pose;
-    bool found_part = false;
-    std::string bin_side;
-
-    // Check left bins
-    for (auto part : left_bins_parts_)
+    // find the tray on the kit tray stations, the cameras may publish while we read
+    auto world = world_.snapshot();
+    geometry_msgs::msg::Pose tray_pose;
+    std::string station;
+    for (auto camera : {WorldCamera::KTS1, WorldCamera::KTS2})
     {
-        if (part.part.type == part_to_pick.type && part.part.color == part_to_pick.color)
+        auto const &view = world.camera(camera);
+        for (auto const &tray : view.trays())
         {
-            part_pose = Utils::multiply_poses(left_bins_camera_pose_, part.pose);
-            found_part = true;
-            bin_side = "left_bins";
-            break;
+            if (tray.id != tray_id)
+                continue;
+            tray_pose = Utils::multiply_poses(view.sensor_pose(), tray.pose);
+            station = camera == WorldCamera::KTS1 ? "kts1" : "kts2";
         }
+        if (!station.empty())
+            break;
     }
-    // Check right bins
-    if (!found_part)
+    if (station.empty())
     {
-        for (auto part : right_bins_parts_)
-        {
-            if (part.part.type == part_to_pick.type && part.part.color == part_to_pick.color)
-            {
-                part_pose = Utils::multiply_poses(right_bins_camera_pose_, part.pose);
-                found_part = true;
-                bin_side = "right_bins";
-                break;
-            }
-        }
+        RCLCPP_ERROR_STREAM(get_logger(), "Unable to locate tray " << tray_id << " in world snapshot " << world.sequence);
+        return false;
+    }
+
+    int kts = station == "kts1" ? robot_commander_msgs::srv::MoveRobotToTable::Request::KTS1
+                                : robot_commander_msgs::srv::MoveRobotToTable::Request::KTS2;
+    if (!move_robot_to_table_(kts))
+        return false;
+
+    // the gripper is changed on the table of the tray, once for all the trays of a batch
+    if (floor_gripper_state_.snapshot()->type != "tray_gripper")
+    {
+        if (!change_gripper_(station, "trays") || !move_robot_to_table_(kts))
+            return false;
     }
-    if (!found_part)
+
+    set_gripper_state_(true);
+    if (!move_robot_to_tray_(tray_id, tray_pose))
+        return false;
+    if (!place_tray_(tray_id, agv_num))
+        return false;
+
+    return lock_tray_(agv_num);
+}
+
+//=============================================//
+bool FloorRobot::pick_bin_part_(ariac_msgs::msg::Part part_to_pick)
+{
+    return pick_bin_part_(part_to_pick, refresh_current_state_().getVariablePosition("linear_actuator_joint"));
+}
+
+//=============================================//
+bool FloorRobot::pick_bin_part_(ariac_msgs::msg::Part part_to_pick, double rail_position)
+{
+    RCLCPP_INFO_STREAM(get_logger(), "Attempting to pick a " << part_colors_[part_to_pick.color] << " " << part_types_[part_to_pick.type]);
+
+    // Find the part nearest to the rail position in one of the bins, the cameras may publish while we read
+    auto world = world_.snapshot();
+    geometry_msgs::msg::Pose part_pose;
+    WorldCamera bins = WorldCamera::LEFT_BINS;
+
+    if (!world.nearest_bin_part(part_to_pick.type, part_to_pick.color, rail_position, part_pose, bins))
     {
-        RCLCPP_ERROR(get_logger(), "Unable to locate part");
+        RCLCPP_ERROR_STREAM(get_logger(), "Unable to locate part in world snapshot " << world.sequence);
         return false;
     }
+    std::string bin_side = bins == WorldCamera::LEFT_BINS ? "left_bins" : "right_bins";
 
     double part_rotation = Utils::get_yaw_from_pose_(part_pose);
 
     // Change gripper at location closest to part
-    if (floor_gripper_state_.type != "part_gripper")
+    if (floor_gripper_state_.snapshot()->type != "part_gripper")
     {
         std::string station;
         if (part_pose.position.y < 0)
@@ -1206,16 +2621,16 @@ bool FloorRobot::pick_bin_part_(ariac_msgs::msg::Part part_to_pick)
     waypoints.push_back(Utils::build_pose(part_pose.position.x, part_pose.position.y,
                                           part_pose.position.z + part_heights_[part_to_pick.type] + pick_offset_, set_robot_orientation_(part_rotation)));
 
-    move_through_waypoints_(waypoints, 0.3, 0.3);
+    move_through_waypoints_(waypoints, MotionClass::APPROACH);
 
     set_gripper_state_(true);
 
     wait_for_attach_completion_(3.0);
 
-    // Add part to planning scene
-    std::string part_name = part_colors_[part_to_pick.color] + "_" + part_types_[part_to_pick.type];
-    add_single_model_to_planning_scene_(part_name, part_types_[part_to_pick.type] + ".stl", part_pose);
-    floor_robot_->attachObject(part_name);
+    // Add part to planning scene, each physical part gets its own id
+    auto part_object_id = add_scene_object_(part_colors_[part_to_pick.color] + "_" + part_types_[part_to_pick.type],
+                                            part_types_[part_to_pick.type] + ".stl", part_pose);
+    attach_scene_object_(part_object_id);
     floor_robot_attached_part_ = part_to_pick;
 
     // Move up slightly
@@ -1223,27 +2638,24 @@ bool FloorRobot::pick_bin_part_(ariac_msgs::msg::Part part_to_pick)
     waypoints.push_back(Utils::build_pose(part_pose.position.x, part_pose.position.y,
                                           part_pose.position.z + 0.3, set_robot_orientation_(0)));
 
-    move_through_waypoints_(waypoints, 0.3, 0.3);
+    move_through_waypoints_(waypoints, MotionClass::LIFT);
 
     return true;
 }
 
 //=============================================//
-bool FloorRobot::place_part_on_tray_(int agv_num, int quadrant)
+bool FloorRobot::place_part_on_tray_(int agv_num, int quadrant, const ariac_msgs::msg::Order *check_order)
 {
-    if (!floor_gripper_state_.attached)
+    if (!floor_gripper_state_.snapshot()->attached)
     {
         RCLCPP_ERROR(get_logger(), "No part attached");
         return false;
     }
 
-    // Move to agv
-    floor_robot_->setJointValueTarget("linear_actuator_joint", rail_positions_["agv" + std::to_string(agv_num)]);
-    floor_robot_->setJointValueTarget("floor_shoulder_pan_joint", 0);
-    move_to_target_();
-
     // Determine target pose for part based on agv_tray pose
-    auto agv_tray_pose = get_pose_in_world_frame_("agv" + std::to_string(agv_num) + "_tray");
+    geometry_msgs::msg::Pose agv_tray_pose;
+    if (!get_pose_in_world_frame_("agv" + std::to_string(agv_num) + "_tray", agv_tray_pose))
+        return false;
 
     auto part_drop_offset = Utils::build_pose(quad_offsets_[quadrant].first, quad_offsets_[quadrant].second, 0.0,
                                               geometry_msgs::msg::Quaternion());
@@ -1259,21 +2671,28 @@ bool FloorRobot::place_part_on_tray_(int agv_num, int quadrant)
                                           part_drop_pose.position.z + part_heights_[floor_robot_attached_part_.type] + drop_height_ + 0.01,
                                           set_robot_orientation_(0)));
 
-    move_through_waypoints_(waypoints, 0.3, 0.3);
+    // Move to agv, the approach is blended with the rail move, or planned while the rail moves
+    std::vector<MotionSegment> segments;
+    segments.push_back(MotionSegment{"rail to agv", {{"linear_actuator_joint", rail_positions_["agv" + std::to_string(agv_num)]}, {"floor_shoulder_pan_joint", 0}}, {}});
+    segments.push_back(MotionSegment{"approach quadrant", {}, waypoints, MotionClass::APPROACH_WITH_PART});
+
+    move_transit_and_approach_(segments[0], segments[1]);
 
     // Drop part in quadrant
     set_gripper_state_(false);
 
-    std::string part_name = part_colors_[floor_robot_attached_part_.color] +
-                            "_" + part_types_[floor_robot_attached_part_.type];
-    floor_robot_->detachObject(part_name);
+    // the kit is checked while the robot retreats
+    if (check_order)
+        quality_checks_->start(check_order->id, check_order->kitting_task);
+
+    detach_scene_object_("agv" + std::to_string(agv_num) + "/" + std::to_string(quadrant));
 
     waypoints.clear();
     waypoints.push_back(Utils::build_pose(part_drop_pose.position.x, part_drop_pose.position.y,
                                           part_drop_pose.position.z + 0.3,
                                           set_robot_orientation_(0)));
 
-    move_through_waypoints_(waypoints, 0.2, 0.1);
+    move_through_waypoints_(waypoints, MotionClass::RETREAT);
 
     return true;
 }
@@ -1300,7 +2719,7 @@ void FloorRobot::remove_part_from_agv_srv_cb_(
 //=============================================//
 bool FloorRobot::remove_part_from_tray_(int agv_num, int quadrant, int part_type, int part_color)
 {
-    if (floor_gripper_state_.attached)
+    if (floor_gripper_state_.snapshot()->attached)
     {
         RCLCPP_ERROR(get_logger(), "Part still attached!");
         return false;
@@ -1312,7 +2731,9 @@ bool FloorRobot::remove_part_from_tray_(int agv_num, int quadrant, int part_type
     // move_to_target_();
 
     // Determine target pose for part based on agv_tray pose
-    auto agv_tray_pose = get_pose_in_world_frame_("agv" + std::to_string(agv_num) + "_tray");
+    geometry_msgs::msg::Pose agv_tray_pose;
+    if (!get_pose_in_world_frame_("agv" + std::to_string(agv_num) + "_tray", agv_tray_pose))
+        return false;
 
     auto part_drop_offset = Utils::build_pose(quad_offsets_[quadrant].first, quad_offsets_[quadrant].second, 0.0,
                                               geometry_msgs::msg::Quaternion());
@@ -1328,17 +2749,17 @@ bool FloorRobot::remove_part_from_tray_(int agv_num, int quadrant, int part_type
                                           part_drop_pose.position.z + part_heights_[part_type] + pick_offset_ + 0.01,
                                           set_robot_orientation_(0)));
 
-    move_through_waypoints_(waypoints, 0.3, 0.3);
+    move_through_waypoints_(waypoints, MotionClass::APPROACH);
 
-    wait_for_attach_completion_(10.0, 0.002);
+    wait_for_attach_completion_(10.0, MotionClass::PART_REMOVAL_DESCENT);
 
-    if (floor_gripper_state_.attached)
+    if (floor_gripper_state_.snapshot()->attached)
     {
         RCLCPP_INFO(this->get_logger(),"~~~~~~~~~~ Object attached! ~~~~~~~~~~");
-        // Add part to planning scene
-        std::string part_name = part_colors_[part_color] + "_" + part_types_[part_type];
-        // add_single_model_to_planning_scene_(part_name, part_types_[part_type_] + ".stl", part_pose_);
-        floor_robot_->attachObject(part_name);
+        // The part is already in the planning scene if this robot placed it
+        auto part_object_id = scene_objects_.find(part_colors_[part_color] + "_" + part_types_[part_type],
+                                                  "agv" + std::to_string(agv_num) + "/" + std::to_string(quadrant));
+        attach_scene_object_(part_object_id);
 
         auto part_to_pick = ariac_msgs::msg::Part();
         part_to_pick.type = part_type;
@@ -1346,24 +2767,29 @@ bool FloorRobot::remove_part_from_tray_(int agv_num, int quadrant, int part_type
         floor_robot_attached_part_ = part_to_pick;
         RCLCPP_INFO_STREAM(get_logger(), "Adding to the planning scene");
 
-        // raise gripper
+        // raise gripper, the move to the disposal bin is planned while raising
+        std::vector<MotionSegment> segments;
         waypoints.clear();
         waypoints.push_back(Utils::build_pose(part_drop_pose.position.x, part_drop_pose.position.y,
                                           part_drop_pose.position.z + 0.3, set_robot_orientation_(0)));
-        move_through_waypoints_(waypoints, 0.3, 0.3); 
+        segments.push_back(MotionSegment{"raise part", {}, waypoints, MotionClass::LIFT});
 
         // move towards the central disposal bin
         // floor_robot_->setJointValueTarget(drop_disposal_js_);
         // move_to_target_();
+        waypoints.clear();
         waypoints.push_back(Utils::build_pose(-2.2, 0.0,
                                           0.8, set_robot_orientation_(0)));
         waypoints.push_back(Utils::build_pose(-2.2, 0.0,
-                                          0.5, set_robot_orientation_(0)));                                   
-        move_through_waypoints_(waypoints, 0.3, 0.3); 
+                                          0.5, set_robot_orientation_(0)));
+        segments.push_back(MotionSegment{"move to disposal bin", {}, waypoints, MotionClass::APPROACH_WITH_PART});
+
+        execute_motion_pipeline_(segments);
 
-        // Drop part in quadrant
+        // Drop part in the disposal bin, it leaves the cell
         set_gripper_state_(false);
-        floor_robot_->detachObject(part_name);              
+        detach_scene_object_("disposal");
+        collect_scene_objects_("disposal");
 
         return true;
     }
@@ -1377,69 +2803,238 @@ bool FloorRobot::remove_part_from_tray_(int agv_num, int quadrant, int part_type
 //=============================================//
 bool FloorRobot::complete_orders_()
 {
-    // Wait for first order to be published
-    while (orders_.size() == 0)
+    while (true)
     {
+        // the kits waiting for a quality check are handled between two orders
+        auto result = orders_.pop(current_order_, kit_checks_.empty() ? order_wait_timeout_ : quality_check_poll_period_);
+        if (result != WaitResult::CANCELLED)
+            service_kit_checks_();
+        if (result == WaitResult::TIMEOUT)
+        {
+            if (kit_checks_.empty())
+                RCLCPP_INFO(get_logger(), "Waiting for orders...");
+            continue;
+        }
+        if (result == WaitResult::DRAINED)
+        {
+            wait_kit_checks_(0);
+            if (!shipping_.wait_all(agv_wait_timeout_))
+                RCLCPP_ERROR(get_logger(), "Shipments still in progress");
+            RCLCPP_INFO(get_logger(), "Completed all orders");
+            return true;
+        }
+        if (result == WaitResult::CANCELLED)
+        {
+            RCLCPP_INFO(get_logger(), "Competition ended");
+            return false;
+        }
+
+        if (current_order_.order.type != ariac_msgs::msg::Order::KITTING)
+        {
+            RCLCPP_INFO(get_logger(), "Ignoring non-kitting tasks.");
+            continue;
+        }
+
+        if (batch_planning_)
+        {
+            complete_kitting_batch_(current_order_);
+            continue;
+        }
+
+        // the AGV of the kit may still be carrying a previous one
+        int kitting_agv_num = current_order_.order.kitting_task.agv_number;
+        wait_kit_checks_(kitting_agv_num);
+        if (!shipping_.wait_shipped(kitting_agv_num, agv_wait_timeout_))
+            RCLCPP_ERROR_STREAM(get_logger(), "AGV " << kitting_agv_num << " is still shipping an order");
+
+        if (!FloorRobot::complete_kitting_task_(current_order_))
+        {
+            RCLCPP_INFO_STREAM(get_logger(), "Order " << current_order_.order.id << " preempted after "
+                                                      << current_order_.parts_placed << " parts");
+            current_order_.preemptions++;
+            orders_.requeue(current_order_);
+        }
     }
+}
 
-    bool success;
-    while (true)
+//=============================================//
+void FloorRobot::collect_batch_orders_(std::vector<OrderProgress> &batch)
+{
+    std::vector<OrderProgress> deferred;
+    OrderProgress progress;
+    while (orders_.pop(progress, 0.0) == WaitResult::READY)
     {
-        if (competition_state_ == ariac_msgs::msg::CompetitionState::ENDED)
+        if (progress.order.type != ariac_msgs::msg::Order::KITTING)
         {
-            success = false;
-            break;
+            RCLCPP_INFO(get_logger(), "Ignoring non-kitting tasks.");
+            continue;
         }
 
-        if (orders_.size() == 0)
+        // a kit joins the batch only if its AGV is free
+        int agv_num = progress.order.kitting_task.agv_number;
+        bool agv_busy = !shipping_.wait_shipped(agv_num, 0.0) ||
+                        std::any_of(kit_checks_.begin(), kit_checks_.end(), [agv_num](const KitCheck &check)
+                                    { return check.progress.order.kitting_task.agv_number == agv_num; }) ||
+                        std::any_of(batch.begin(), batch.end(), [agv_num](const OrderProgress &other)
+                                    { return other.order.kitting_task.agv_number == agv_num; });
+        if (agv_busy)
+            deferred.push_back(progress);
+        else
+            batch.push_back(progress);
+    }
+
+    for (auto const &order : deferred)
+        orders_.requeue(order);
+}
+
+//=============================================//
+void FloorRobot::complete_kitting_batch_(const OrderProgress &first)
+{
+    int first_agv_num = first.order.kitting_task.agv_number;
+    wait_kit_checks_(first_agv_num);
+    if (!shipping_.wait_shipped(first_agv_num, agv_wait_timeout_))
+        RCLCPP_ERROR_STREAM(get_logger(), "AGV " << first_agv_num << " is still shipping an order");
+
+    std::vector<OrderProgress> batch{first};
+    collect_batch_orders_(batch);
+
+    go_home_();
+
+    while (!batch.empty())
+    {
+        service_kit_checks_();
+
+        // plan the remaining parts of the batch, again after each part as orders may have joined
+        std::vector<BatchJob> jobs;
+        for (auto const &progress : batch)
         {
-            if (competition_state_ != ariac_msgs::msg::CompetitionState::ORDER_ANNOUNCEMENTS_DONE)
+            auto const &task = progress.order.kitting_task;
+            if (batch_place_trays_ && !progress.tray_placed)
             {
-                // wait for more orders
-                RCLCPP_INFO(get_logger(), "Waiting for orders...");
-                while (orders_.size() == 0)
-                {
-                }
+                BatchJob job;
+                job.order_id = progress.order.id;
+                job.priority = progress.order.priority;
+                job.agv_num = task.agv_number;
+                job.place_position = rail_positions_["agv" + std::to_string(task.agv_number)];
+                job.gripper = "tray_gripper";
+                job.tray_id = task.tray_id;
+                jobs.push_back(job);
             }
-            else
+            for (std::size_t i = progress.parts_placed; i < task.parts.size(); i++)
             {
-                RCLCPP_INFO(get_logger(), "Completed all orders");
-                success = true;
-                break;
+                BatchJob job;
+                job.order_id = progress.order.id;
+                job.priority = progress.order.priority;
+                job.part = task.parts[i].part;
+                job.agv_num = task.agv_number;
+                job.quadrant = task.parts[i].quadrant;
+                job.place_position = rail_positions_["agv" + std::to_string(task.agv_number)];
+                jobs.push_back(job);
             }
         }
 
-        current_order_ = orders_.front();
-        orders_.erase(orders_.begin());
-        int kitting_agv_num = -1;
+        double seconds = 0.0;
+        auto steps = batch_planner_->plan(jobs, world_.snapshot(),
+                                          refresh_current_state_().getVariablePosition("linear_actuator_joint"),
+                                          floor_gripper_state_.snapshot()->type, seconds);
+        RCLCPP_INFO_STREAM(get_logger(), "Batch of " << batch.size() << " kits, " << steps.size()
+                                                     << " parts left, " << seconds << " s on the rail");
 
-        if (current_order_.type == ariac_msgs::msg::Order::KITTING)
+        // the kits are filled in the order of the plan, parts of a kit being placed in any order
+        if (!steps.empty())
         {
-            FloorRobot::complete_kitting_task_(current_order_.kitting_task);
-            kitting_agv_num = current_order_.kitting_task.agv_number;
-        }
-        else
-        {
-            RCLCPP_INFO(get_logger(), "Ignoring non-kitting tasks.");
+            auto const &step = steps.front();
+            auto progress = std::find_if(batch.begin(), batch.end(), [&step](const OrderProgress &order)
+                                         { return order.order.id == step.job.order_id; });
+            if (progress == batch.end())
+            {
+                RCLCPP_ERROR_STREAM(get_logger(), "Order " << step.job.order_id << " is not in the batch");
+                for (auto const &order : batch)
+                    orders_.requeue(order);
+                return;
+            }
+
+            auto &parts = progress->order.kitting_task.parts;
+            auto kit_part = parts.end();
+            bool placed;
+            if (step.job.is_tray())
+            {
+                placed = pick_and_place_tray_(step.job.tray_id, step.job.agv_num);
+            }
+            else
+            {
+                kit_part = std::find_if(parts.begin() + progress->parts_placed, parts.end(),
+                                        [&step](const ariac_msgs::msg::KittingPart &part)
+                                        { return part.quadrant == step.job.quadrant; });
+                bool last = progress->parts_placed + 1 == parts.size() &&
+                            (!batch_place_trays_ || progress->tray_placed);
+                placed = kit_part != parts.end() &&
+                         pick_bin_part_(step.job.part, step.pick_position) &&
+                         place_part_on_tray_(step.job.agv_num, step.job.quadrant, last ? &progress->order : nullptr);
+            }
+
+            // the order stays in the batch, keeping its AGV, and the step is planned again
+            if (!placed)
+            {
+                progress->failures++;
+                RCLCPP_ERROR_STREAM(get_logger(), "Unable to fill the kit of order " << progress->order.id << " ("
+                                                                                     << progress->failures << "/"
+                                                                                     << batch_max_failures_
+                                                                                     << " failures)");
+                go_home_();
+            }
+            else if (step.job.is_tray())
+            {
+                progress->tray_placed = true;
+            }
+            else
+            {
+                std::iter_swap(parts.begin() + progress->parts_placed, kit_part);
+                progress->parts_placed++;
+            }
         }
 
-        // loop until the AGV is at the warehouse
-        auto agv_location = -1;
-        while (agv_location != ariac_msgs::msg::AGVStatus::WAREHOUSE)
+        // ship the complete kits, and the kits given up after too many failures as they are
+        for (auto progress = batch.begin(); progress != batch.end();)
         {
-            if (kitting_agv_num == 1)
-                agv_location = agv_locations_[1];
-            else if (kitting_agv_num == 2)
-                agv_location = agv_locations_[2];
-            else if (kitting_agv_num == 3)
-                agv_location = agv_locations_[3];
-            else if (kitting_agv_num == 4)
-                agv_location = agv_locations_[4];
+            bool complete = progress->parts_placed == progress->order.kitting_task.parts.size() &&
+                            (!batch_place_trays_ || progress->tray_placed);
+            bool given_up = static_cast<int>(progress->failures) >= batch_max_failures_;
+            if (!complete && !given_up)
+            {
+                progress++;
+                continue;
+            }
+            // the check of a kit completed by a part started when the part was released
+            if (!complete)
+                RCLCPP_ERROR_STREAM(get_logger(), "Shipping the partial kit of order " << progress->order.id
+                                                                                       << " with "
+                                                                                       << progress->parts_placed
+                                                                                       << " parts");
+            if (!complete || progress->order.kitting_task.parts.empty())
+                quality_checks_->start(progress->order.id, progress->order.kitting_task);
+
+            finish_kit_(*progress);
+            progress = batch.erase(progress);
         }
 
-        FloorRobot::submit_order_(current_order_.id);
+        collect_batch_orders_(batch);
     }
-    return success;
+}
+
+//=============================================//
+void FloorRobot::report_shipment_(const std::string &order_id, int agv_num, bool submitted)
+{
+    if (!submitted)
+    {
+        RCLCPP_ERROR_STREAM(get_logger(), "Order " << order_id << " on AGV " << agv_num << " not submitted");
+        return;
+    }
+
+    RCLCPP_INFO_STREAM(get_logger(), "Order " << order_id << " on AGV " << agv_num << " submitted");
+    std_msgs::msg::String msg;
+    msg.data = order_id;
+    submitted_order_pub_->publish(msg);
 }
 
 //=============================================//
@@ -1458,30 +3053,150 @@ bool FloorRobot::submit_order_(std::string order_id)
 }
 
 //=============================================//
-bool FloorRobot::complete_kitting_task_(ariac_msgs::msg::KittingTask task)
+bool FloorRobot::complete_kitting_task_(OrderProgress &progress)
 {
+    auto const &task = progress.order.kitting_task;
 
     go_home_();
 
-    for (auto kit_part : task.parts)
+    while (progress.parts_placed < task.parts.size())
     {
+        // safe point, the gripper holds nothing
+        service_kit_checks_();
+
+        // preemption point, the tray is left with the parts placed so far
+        if (progress.parts_placed > 0 && orders_.preempts(progress))
+            return false;
+
+        auto const &kit_part = task.parts[progress.parts_placed];
+        bool last = progress.parts_placed + 1 == task.parts.size();
         pick_bin_part_(kit_part.part);
-        place_part_on_tray_(task.agv_number, kit_part.quadrant);
+        place_part_on_tray_(task.agv_number, kit_part.quadrant, last ? &progress.order : nullptr);
+        progress.parts_placed++;
     }
 
-    // Check quality
-    auto request = std::make_shared<ariac_msgs::srv::PerformQualityCheck::Request>();
-    request->order_id = current_order_.id;
-    auto result = quality_checker_->async_send_request(request);
-    result.wait();
+    // an empty kit has no part whose release starts the check
+    if (task.parts.empty())
+        quality_checks_->start(progress.order.id, task);
 
-    if (!result.get()->all_passed)
+    finish_kit_(progress);
+    return true;
+}
+
+//=============================================//
+void FloorRobot::finish_kit_(const OrderProgress &progress)
+{
+    kit_checks_.push_back(KitCheck{progress, 1, std::chrono::steady_clock::now()});
+
+    log_trajectory_cache_stats_();
+}
+
+//=============================================//
+void FloorRobot::service_kit_checks_()
+{
+    for (auto check = kit_checks_.begin(); check != kit_checks_.end();)
     {
-        RCLCPP_ERROR(get_logger(), "Issue with shipment");
+        if (resolve_kit_check_(*check))
+            check = kit_checks_.erase(check);
+        else
+            check++;
     }
+}
 
-    // move agv to destination
-    move_agv_(task.agv_number, task.destination);
+//=============================================//
+void FloorRobot::wait_kit_checks_(int agv_num)
+{
+    while (true)
+    {
+        service_kit_checks_();
+
+        auto check = std::find_if(kit_checks_.begin(), kit_checks_.end(), [agv_num](const KitCheck &kit)
+                                  { return agv_num == 0 || kit.progress.order.kitting_task.agv_number == agv_num; });
+        if (check == kit_checks_.end())
+            return;
 
+        // wakes up on the verdict, or to time out the check
+        bool all_passed = false;
+        quality_checks_->wait(check->progress.order.id, quality_check_poll_period_, all_passed);
+    }
+}
+
+//=============================================//
+bool FloorRobot::resolve_kit_check_(KitCheck &check)
+{
+    auto const &order = check.progress.order;
+
+    bool all_passed = false;
+    if (quality_checks_->wait(order.id, 0.0, all_passed) != WaitResult::READY)
+    {
+        std::chrono::duration<double> waited = std::chrono::steady_clock::now() - check.started;
+        if (waited.count() < quality_check_timeout_)
+            return false;
+        RCLCPP_ERROR_STREAM(get_logger(), "No quality check result for order " << order.id);
+    }
+    else if (!all_passed)
+    {
+        auto faulty_parts = quality_checks_->take_faulty(order.id);
+        if (faulty_parts.empty() || check.round >= quality_check_max_rounds_)
+        {
+            RCLCPP_ERROR_STREAM(get_logger(), "Issue with shipment of order " << order.id);
+        }
+        else
+        {
+            // replace the faulty parts, the last release starts the next check
+            bool replaced = true;
+            for (std::size_t i = 0; i < faulty_parts.size() && replaced; i++)
+            {
+                auto const &faulty = faulty_parts[i];
+                RCLCPP_INFO_STREAM(get_logger(), "Replacing faulty part on quadrant " << faulty.quadrant
+                                                                                  << " of AGV " << faulty.agv_num);
+                replaced = replace_faulty_part_(faulty, i + 1 == faulty_parts.size() ? &order : nullptr);
+                if (!replaced)
+                    RCLCPP_ERROR_STREAM(get_logger(), "Unable to replace faulty part on quadrant " << faulty.quadrant
+                                                                                                   << " of AGV " << faulty.agv_num);
+            }
+            if (replaced)
+            {
+                check.round++;
+                check.started = std::chrono::steady_clock::now();
+                return false;
+            }
+
+            RCLCPP_ERROR_STREAM(get_logger(), "Issue with shipment of order " << order.id);
+            go_home_();
+        }
+    }
+
+    ship_kit_(order);
     return true;
+}
+
+//=============================================//
+void FloorRobot::ship_kit_(const ariac_msgs::msg::Order &order)
+{
+    auto const &task = order.kitting_task;
+    move_agv_(task.agv_number, task.destination);
+
+    // submitted in the background once the AGV reaches the warehouse
+    shipping_.track(order.id, task.agv_number, agv_wait_timeout_);
+}
+
+//=============================================//
+bool FloorRobot::replace_faulty_part_(const FaultyPart &faulty, const ariac_msgs::msg::Order *check_order)
+{
+    // the gripper was disabled when the last part was dropped
+    if (!floor_gripper_state_.snapshot()->enabled && !set_gripper_state_(true))
+        return false;
+
+    floor_robot_->setJointValueTarget("linear_actuator_joint", rail_positions_["agv" + std::to_string(faulty.agv_num)]);
+    floor_robot_->setJointValueTarget("floor_shoulder_pan_joint", 0);
+    if (!move_to_target_())
+        return false;
+
+    if (!remove_part_from_tray_(faulty.agv_num, faulty.quadrant, faulty.part.type, faulty.part.color))
+        return false;
+    if (!pick_bin_part_(faulty.part))
+        return false;
+
+    return place_part_on_tray_(faulty.agv_num, faulty.quadrant, check_order);
 }
\ No newline at end of file
@@ -0,0 +1,120 @@
+#include "frame_pose_cache.hpp"
+
+#include "tf2/exceptions.h"
+
+//=============================================//
+FramePoseCache::FramePoseCache(tf2_ros::Buffer &buffer, const std::string &reference_frame)
+    : buffer_(buffer), reference_frame_(reference_frame)
+{
+}
+
+//=============================================//
+FrameLookup FramePoseCache::lookup(const std::string &frame, double timeout)
+{
+    FrameLookup result;
+    uint64_t generation;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        auto it = poses_.find(frame);
+        if (it != poses_.end())
+        {
+            stats_.hits++;
+            result.pose = it->second;
+            result.cached = true;
+            return result;
+        }
+        stats_.lookups++;
+        generation = generation_;
+    }
+
+    // the lock is not held while waiting for TF
+    try
+    {
+        auto t = buffer_.lookupTransform(reference_frame_, frame, tf2::TimePointZero, tf2::durationFromSec(timeout));
+
+        geometry_msgs::msg::Pose pose;
+        pose.position.x = t.transform.translation.x;
+        pose.position.y = t.transform.translation.y;
+        pose.position.z = t.transform.translation.z;
+        pose.orientation = t.transform.rotation;
+        result.pose = pose;
+    }
+    catch (const tf2::LookupException &ex)
+    {
+        result.error = FrameLookupError::UNKNOWN_FRAME;
+        result.message = ex.what();
+    }
+    catch (const tf2::ConnectivityException &ex)
+    {
+        result.error = FrameLookupError::DISCONNECTED;
+        result.message = ex.what();
+    }
+    catch (const tf2::ExtrapolationException &ex)
+    {
+        result.error = FrameLookupError::EXTRAPOLATION;
+        result.message = ex.what();
+    }
+    catch (const tf2::TimeoutException &ex)
+    {
+        result.error = FrameLookupError::TIMEOUT;
+        result.message = ex.what();
+    }
+    catch (const tf2::TransformException &ex)
+    {
+        result.error = FrameLookupError::OTHER;
+        result.message = ex.what();
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!result.pose)
+        stats_.failures++;
+    else if (generation == generation_) // a pose looked up while the frame was invalidated may already be stale
+        poses_[frame] = *result.pose;
+
+    return result;
+}
+
+//=============================================//
+void FramePoseCache::invalidate(const std::string &frame)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    poses_.erase(frame);
+    generation_++;
+}
+
+//=============================================//
+void FramePoseCache::clear()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    poses_.clear();
+    generation_++;
+}
+
+//=============================================//
+FramePoseCache::Stats FramePoseCache::stats() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+//=============================================//
+std::string FramePoseCache::error_name(FrameLookupError error)
+{
+    switch (error)
+    {
+    case FrameLookupError::NONE:
+        return "none";
+    case FrameLookupError::UNKNOWN_FRAME:
+        return "unknown frame";
+    case FrameLookupError::DISCONNECTED:
+        return "disconnected";
+    case FrameLookupError::EXTRAPOLATION:
+        return "extrapolation";
+    case FrameLookupError::TIMEOUT:
+        return "timeout";
+    case FrameLookupError::OTHER:
+        return "other";
+    }
+    return "unknown";
+}
@@ -0,0 +1,48 @@
+#include "gripper_state_channel.hpp"
+
+GripperStateChannel::GripperStateChannel()
+    : snapshot_(std::make_shared<const ariac_msgs::msg::VacuumGripperState>())
+{
+}
+
+//=============================================//
+void GripperStateChannel::publish(const ariac_msgs::msg::VacuumGripperState &state)
+{
+    auto snapshot = std::make_shared<const ariac_msgs::msg::VacuumGripperState>(state);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::atomic_store(&snapshot_, Snapshot(snapshot));
+    }
+    changed_.notify_all();
+}
+
+//=============================================//
+GripperStateChannel::Snapshot GripperStateChannel::snapshot() const
+{
+    return std::atomic_load(&snapshot_);
+}
+
+//=============================================//
+bool GripperStateChannel::wait_for(const Predicate &predicate, double timeout) const
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    return changed_.wait_for(lock, std::chrono::duration<double>(timeout),
+                             [this, &predicate]()
+                             { return predicate(*snapshot_); });
+}
+
+//=============================================//
+bool GripperStateChannel::wait_until_attached(double timeout) const
+{
+    return wait_for([](const ariac_msgs::msg::VacuumGripperState &state)
+                    { return state.attached; },
+                    timeout);
+}
+
+//=============================================//
+bool GripperStateChannel::wait_until_enabled(bool enabled, double timeout) const
+{
+    return wait_for([enabled](const ariac_msgs::msg::VacuumGripperState &state)
+                    { return state.enabled == enabled && (enabled || !state.attached); },
+                    timeout);
+}
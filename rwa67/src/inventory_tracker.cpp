@@ -0,0 +1,162 @@
+#include "inventory_tracker.hpp"
+
+#include <cmath>
+
+#include "utils.hpp"
+
+namespace
+{
+    // FNV-1a
+    constexpr uint64_t FNV_OFFSET = 14695981039346656037ULL;
+    constexpr uint64_t FNV_PRIME = 1099511628211ULL;
+
+    void hash_value(uint64_t &hash, int64_t value)
+    {
+        for (int byte = 0; byte < 8; byte++)
+        {
+            hash ^= static_cast<uint64_t>(value >> (8 * byte)) & 0xff;
+            hash *= FNV_PRIME;
+        }
+    }
+
+    void hash_pose(uint64_t &hash, const geometry_msgs::msg::Pose &pose, double quantum)
+    {
+        for (double value : {pose.position.x, pose.position.y, pose.position.z,
+                             pose.orientation.x, pose.orientation.y, pose.orientation.z, pose.orientation.w})
+            hash_value(hash, std::llround(value / quantum));
+    }
+
+    double distance(const geometry_msgs::msg::Pose &a, const geometry_msgs::msg::Pose &b)
+    {
+        double dx = a.position.x - b.position.x;
+        double dy = a.position.y - b.position.y;
+        double dz = a.position.z - b.position.z;
+        return std::sqrt(dx * dx + dy * dy + dz * dz);
+    }
+
+    bool same_kind(const custom_msgs::msg::InventoryItem &a, const custom_msgs::msg::InventoryItem &b)
+    {
+        if (a.kind != b.kind)
+            return false;
+        if (a.kind == custom_msgs::msg::InventoryItem::TRAY)
+            return a.tray_id == b.tray_id;
+        return a.type == b.type && a.color == b.color;
+    }
+} // namespace
+
+//=============================================//
+InventoryTracker::InventoryTracker(std::atomic<uint32_t> &next_id, double match_distance, double move_tolerance)
+    : next_id_(next_id), match_distance_(match_distance), move_tolerance_(move_tolerance)
+{
+}
+
+//=============================================//
+uint64_t InventoryTracker::hash_(const ariac_msgs::msg::AdvancedLogicalCameraImage &image) const
+{
+    uint64_t hash = FNV_OFFSET;
+
+    hash_pose(hash, image.sensor_pose, move_tolerance_);
+    for (auto const &part : image.part_poses)
+    {
+        hash_value(hash, part.part.type);
+        hash_value(hash, part.part.color);
+        hash_pose(hash, part.pose, move_tolerance_);
+    }
+    // separate the parts from the trays
+    hash_value(hash, -1);
+    for (auto const &tray : image.tray_poses)
+    {
+        hash_value(hash, tray.id);
+        hash_pose(hash, tray.pose, move_tolerance_);
+    }
+
+    return hash;
+}
+
+//=============================================//
+void InventoryTracker::match_(const custom_msgs::msg::InventoryItem &item, custom_msgs::msg::InventoryDelta &delta)
+{
+    Tracked *best = nullptr;
+    double best_distance = match_distance_;
+    for (auto &tracked : tracked_)
+    {
+        if (tracked.matched || !same_kind(tracked.item, item))
+            continue;
+
+        double d = distance(tracked.item.pose, item.pose);
+        if (d <= best_distance)
+        {
+            best = &tracked;
+            best_distance = d;
+        }
+    }
+
+    current_.push_back(Tracked{item, false});
+    auto &current = current_.back().item;
+
+    if (!best)
+    {
+        current.id = ++next_id_;
+        delta.added.push_back(current);
+        return;
+    }
+
+    best->matched = true;
+    current.id = best->item.id;
+    if (best_distance > move_tolerance_)
+        delta.moved.push_back(current);
+    else
+        current.pose = best->item.pose; // small moves do not accumulate into drift
+}
+
+//=============================================//
+bool InventoryTracker::update(const ariac_msgs::msg::AdvancedLogicalCameraImage &image,
+                              custom_msgs::msg::InventoryDelta &delta)
+{
+    auto hash = hash_(image);
+    if (has_frame_ && hash == last_hash_)
+        return false;
+
+    has_frame_ = true;
+    last_hash_ = hash;
+
+    delta.added.clear();
+    delta.removed.clear();
+    delta.moved.clear();
+    current_.clear();
+
+    custom_msgs::msg::InventoryItem item;
+    item.kind = custom_msgs::msg::InventoryItem::PART;
+    for (auto const &part : image.part_poses)
+    {
+        item.type = part.part.type;
+        item.color = part.part.color;
+        item.pose = Utils::multiply_poses(image.sensor_pose, part.pose);
+        match_(item, delta);
+    }
+
+    item = custom_msgs::msg::InventoryItem();
+    item.kind = custom_msgs::msg::InventoryItem::TRAY;
+    for (auto const &tray : image.tray_poses)
+    {
+        item.tray_id = tray.id;
+        item.pose = Utils::multiply_poses(image.sensor_pose, tray.pose);
+        match_(item, delta);
+    }
+
+    for (auto const &tracked : tracked_)
+    {
+        if (!tracked.matched)
+            delta.removed.push_back(tracked.item);
+    }
+
+    tracked_.swap(current_);
+
+    return !delta.added.empty() || !delta.removed.empty() || !delta.moved.empty();
+}
+
+//=============================================//
+std::size_t InventoryTracker::size() const
+{
+    return tracked_.size();
+}
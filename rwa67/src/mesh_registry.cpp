@@ -0,0 +1,74 @@
+#include "mesh_registry.hpp"
+
+#include <filesystem>
+
+#include <geometric_shapes/shape_operations.h>
+#include <geometric_shapes/shapes.h>
+
+//=============================================//
+std::size_t MeshRegistry::load_directory(const std::string &directory)
+{
+    std::size_t loaded = 0;
+
+    std::error_code error;
+    for (auto const &entry : std::filesystem::directory_iterator(directory, error))
+    {
+        auto extension = entry.path().extension().string();
+        if (!entry.is_regular_file() || (extension != ".stl" && extension != ".dae" && extension != ".obj"))
+            continue;
+
+        std::unique_ptr<shapes::Mesh> shape(shapes::createMeshFromResource("file://" + entry.path().string()));
+        if (!shape)
+            continue;
+
+        shapes::ShapeMsg shape_msg;
+        if (!shapes::constructMsgFromShape(shape.get(), shape_msg))
+            continue;
+
+        meshes_[entry.path().filename().string()] =
+            std::make_shared<const shape_msgs::msg::Mesh>(boost::get<shape_msgs::msg::Mesh>(shape_msg));
+        loaded++;
+    }
+
+    return loaded;
+}
+
+//=============================================//
+MeshRegistry::MeshConstPtr MeshRegistry::get(const std::string &mesh_file) const
+{
+    auto it = meshes_.find(mesh_file);
+    if (it == meshes_.end())
+        return nullptr;
+
+    return it->second;
+}
+
+//=============================================//
+std::size_t MeshRegistry::build_proxies(double resolution)
+{
+    std::size_t boxes = 0;
+    for (auto const &mesh : meshes_)
+    {
+        auto proxy = std::make_shared<const CollisionProxy>(make_box_proxy(*mesh.second, resolution));
+        boxes += proxy->primitives.size();
+        proxies_[mesh.first] = proxy;
+    }
+
+    return boxes;
+}
+
+//=============================================//
+CollisionProxyConstPtr MeshRegistry::proxy(const std::string &mesh_file) const
+{
+    auto it = proxies_.find(mesh_file);
+    if (it == proxies_.end())
+        return nullptr;
+
+    return it->second;
+}
+
+//=============================================//
+std::size_t MeshRegistry::size() const
+{
+    return meshes_.size();
+}
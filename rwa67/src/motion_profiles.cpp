@@ -0,0 +1,165 @@
+#include "motion_profiles.hpp"
+
+#include <algorithm>
+#include <sstream>
+
+//=============================================//
+std::string MotionProfileTable::class_name(MotionClass motion_class)
+{
+    switch (motion_class)
+    {
+    case MotionClass::FREE_TRANSIT:
+        return "free_transit";
+    case MotionClass::APPROACH:
+        return "approach";
+    case MotionClass::APPROACH_WITH_PART:
+        return "approach_with_part";
+    case MotionClass::APPROACH_WITH_TRAY:
+        return "approach_with_tray";
+    case MotionClass::GRASP_DESCENT:
+        return "grasp_descent";
+    case MotionClass::RETREAT:
+        return "retreat";
+    case MotionClass::PART_REMOVAL_DESCENT:
+        return "part_removal_descent";
+    case MotionClass::LIFT:
+        return "lift";
+    case MotionClass::TRAY_LIFT:
+        return "tray_lift";
+    case MotionClass::TOOL_CHANGE:
+        return "tool_change";
+    }
+    return "unknown";
+}
+
+//=============================================//
+MotionProfile MotionProfileTable::scaled_(const MotionProfile &profile, double multiplier)
+{
+    MotionProfile scaled;
+    scaled.vsf = std::min(1.0, profile.vsf * multiplier);
+    scaled.asf = std::min(1.0, profile.asf * multiplier);
+    scaled.max_speed = profile.max_speed * multiplier;
+    return scaled;
+}
+
+//=============================================//
+void MotionProfileTable::set_profile(MotionClass motion_class, const MotionProfile &profile)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    profiles_[static_cast<std::size_t>(motion_class)] = profile;
+}
+
+//=============================================//
+MotionProfile MotionProfileTable::profile(MotionClass motion_class) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    auto index = static_cast<std::size_t>(motion_class);
+    if (!calibration_[index].active)
+        return profiles_[index];
+
+    return scaled_(base_profiles_[index], calibration_[index].multiplier);
+}
+
+//=============================================//
+void MotionProfileTable::start_calibration(double step, double max_multiplier, int trials, double max_tracking_error)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    step_ = step;
+    max_multiplier_ = max_multiplier;
+    trials_ = std::max(1, trials);
+    max_tracking_error_ = max_tracking_error;
+
+    base_profiles_ = profiles_;
+    for (std::size_t i = 0; i < CLASS_COUNT; i++)
+    {
+        calibration_[i] = Calibration();
+        // nothing to sweep once both factors are at their maximum
+        calibration_[i].active = step_ > 0.0 && (profiles_[i].vsf < 1.0 || profiles_[i].asf < 1.0);
+        calibration_[i].multiplier = 1.0 + step_;
+    }
+}
+
+//=============================================//
+bool MotionProfileTable::calibrating() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    for (auto const &calibration : calibration_)
+    {
+        if (calibration.active)
+            return true;
+    }
+    return false;
+}
+
+//=============================================//
+bool MotionProfileTable::record(MotionClass motion_class, bool success, double tracking_error)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    auto index = static_cast<std::size_t>(motion_class);
+    auto &calibration = calibration_[index];
+    if (!calibration.active)
+        return false;
+
+    // the candidate is too fast, keep the last safe profile
+    if (!success || tracking_error > max_tracking_error_)
+    {
+        calibration.active = false;
+        return true;
+    }
+
+    calibration.successes++;
+    calibration.max_tracking_error = std::max(calibration.max_tracking_error, tracking_error);
+    if (calibration.successes < trials_)
+        return false;
+
+    // the candidate becomes the safe profile, try a faster one
+    profiles_[index] = scaled_(base_profiles_[index], calibration.multiplier);
+    double next_multiplier = calibration.multiplier + step_;
+    calibration = Calibration();
+    calibration.multiplier = next_multiplier;
+    calibration.active = (profiles_[index].vsf < 1.0 || profiles_[index].asf < 1.0) && next_multiplier <= max_multiplier_;
+    return true;
+}
+
+//=============================================//
+std::string MotionProfileTable::to_yaml(const std::string &node_name) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    std::stringstream yaml;
+    yaml << node_name << ":\n"
+         << "  ros__parameters:\n"
+         << "    motion_profiles:\n";
+    for (std::size_t i = 0; i < CLASS_COUNT; i++)
+    {
+        yaml << "      " << class_name(static_cast<MotionClass>(i)) << ":\n"
+             << "        velocity_scaling: " << profiles_[i].vsf << "\n"
+             << "        acceleration_scaling: " << profiles_[i].asf << "\n"
+             << "        max_speed: " << profiles_[i].max_speed << "\n";
+    }
+    return yaml.str();
+}
+
+//=============================================//
+std::string MotionProfileTable::report() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    std::stringstream message;
+    for (std::size_t i = 0; i < CLASS_COUNT; i++)
+    {
+        message << class_name(static_cast<MotionClass>(i)) << ": vsf " << profiles_[i].vsf
+                << ", asf " << profiles_[i].asf;
+        if (profiles_[i].max_speed > 0.0)
+            message << ", max speed " << profiles_[i].max_speed << " m/s";
+        if (calibration_[i].active)
+            message << " (trying x" << calibration_[i].multiplier << ", "
+                    << calibration_[i].successes << "/" << trials_ << " successes)";
+        message << "; ";
+    }
+    return message.str();
+}
@@ -0,0 +1,114 @@
+#include "motion_roadmap.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+MotionRoadmap::MotionRoadmap(double tolerance)
+    : tolerance_(tolerance)
+{
+}
+
+//=============================================//
+double MotionRoadmap::max_joint_difference_(const std::vector<double> &a, const std::vector<double> &b)
+{
+    if (a.size() != b.size())
+        return std::numeric_limits<double>::infinity();
+
+    double max_difference = 0.0;
+    for (std::size_t i = 0; i < a.size(); i++)
+        max_difference = std::max(max_difference, std::fabs(a[i] - b[i]));
+
+    return max_difference;
+}
+
+//=============================================//
+bool MotionRoadmap::add_node(const std::string &name, const std::vector<double> &joint_values)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (nodes_.count(name))
+        return false;
+
+    // two names for the same configuration would only duplicate edges
+    for (auto const &node : nodes_)
+    {
+        if (max_joint_difference_(node.second, joint_values) <= tolerance_)
+            return false;
+    }
+
+    nodes_[name] = joint_values;
+    return true;
+}
+
+//=============================================//
+std::vector<std::string> MotionRoadmap::node_names() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    std::vector<std::string> names;
+    for (auto const &node : nodes_)
+        names.push_back(node.first);
+
+    return names;
+}
+
+//=============================================//
+bool MotionRoadmap::get_node(const std::string &name, std::vector<double> &joint_values) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    auto it = nodes_.find(name);
+    if (it == nodes_.end())
+        return false;
+
+    joint_values = it->second;
+    return true;
+}
+
+//=============================================//
+std::string MotionRoadmap::nearest_node(const std::vector<double> &joint_values) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    std::string nearest;
+    double nearest_difference = tolerance_;
+    for (auto const &node : nodes_)
+    {
+        double difference = max_joint_difference_(node.second, joint_values);
+        if (difference <= nearest_difference)
+        {
+            nearest = node.first;
+            nearest_difference = difference;
+        }
+    }
+
+    return nearest;
+}
+
+//=============================================//
+void MotionRoadmap::set_edge(const std::string &from, const std::string &to, const moveit_msgs::msg::RobotTrajectory &trajectory)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    edges_[std::make_pair(from, to)] = trajectory;
+}
+
+//=============================================//
+bool MotionRoadmap::get_edge(const std::string &from, const std::string &to, moveit_msgs::msg::RobotTrajectory &trajectory) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    auto it = edges_.find(std::make_pair(from, to));
+    if (it == edges_.end())
+        return false;
+
+    trajectory = it->second;
+    return true;
+}
+
+//=============================================//
+std::size_t MotionRoadmap::edge_count() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return edges_.size();
+}
@@ -0,0 +1,126 @@
+#include "order_queue.hpp"
+
+#include <algorithm>
+#include <chrono>
+
+//=============================================//
+bool OrderQueue::LessUrgent::operator()(const OrderProgress &a, const OrderProgress &b) const
+{
+    if (a.order.priority != b.order.priority)
+        return b.order.priority;
+    return a.arrival > b.arrival;
+}
+
+//=============================================//
+void OrderQueue::push(const ariac_msgs::msg::Order &order)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        OrderProgress progress;
+        progress.order = order;
+        progress.arrival = next_arrival_++;
+        orders_.push_back(std::move(progress));
+        std::push_heap(orders_.begin(), orders_.end(), LessUrgent());
+    }
+    changed_.notify_all();
+}
+
+//=============================================//
+void OrderQueue::requeue(const OrderProgress &progress)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        orders_.push_back(progress);
+        std::push_heap(orders_.begin(), orders_.end(), LessUrgent());
+    }
+    changed_.notify_all();
+}
+
+//=============================================//
+WaitResult OrderQueue::pop(OrderProgress &progress, double timeout)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    changed_.wait_for(lock, std::chrono::duration<double>(timeout),
+                      [this]()
+                      { return cancelled_ || drained_ || !orders_.empty(); });
+
+    if (cancelled_)
+        return WaitResult::CANCELLED;
+    if (orders_.empty())
+        return drained_ ? WaitResult::DRAINED : WaitResult::TIMEOUT;
+
+    // the most urgent order that can start, the preempted kit it waits for otherwise
+    auto next = orders_.begin();
+    if (blocked_(*next))
+    {
+        next = orders_.end();
+        for (auto it = orders_.begin(); it != orders_.end(); it++)
+        {
+            if (!blocked_(*it) && (next == orders_.end() || LessUrgent()(*next, *it)))
+                next = it;
+        }
+    }
+
+    progress = std::move(*next);
+    orders_.erase(next);
+    std::make_heap(orders_.begin(), orders_.end(), LessUrgent());
+    return WaitResult::READY;
+}
+
+//=============================================//
+bool OrderQueue::preempts(const OrderProgress &current) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (current.order.priority)
+        return false;
+
+    // the most urgent order may be a kit for the same AGV, which must wait, while another one can start
+    return std::any_of(orders_.begin(), orders_.end(), [&current](const OrderProgress &pending)
+                       { return pending.order.priority && !same_agv_(pending, current); });
+}
+
+//=============================================//
+bool OrderQueue::same_agv_(const OrderProgress &a, const OrderProgress &b)
+{
+    return a.order.type == ariac_msgs::msg::Order::KITTING &&
+           b.order.type == ariac_msgs::msg::Order::KITTING &&
+           a.order.kitting_task.agv_number == b.order.kitting_task.agv_number;
+}
+
+//=============================================//
+bool OrderQueue::blocked_(const OrderProgress &progress) const
+{
+    if (progress.parts_placed > 0 || progress.tray_placed)
+        return false;
+
+    // a kit cannot be started on a tray still holding a preempted kit
+    return std::any_of(orders_.begin(), orders_.end(), [&progress](const OrderProgress &pending)
+                       { return (pending.parts_placed > 0 || pending.tray_placed) && same_agv_(pending, progress); });
+}
+
+//=============================================//
+void OrderQueue::drain()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        drained_ = true;
+    }
+    changed_.notify_all();
+}
+
+//=============================================//
+void OrderQueue::cancel()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        cancelled_ = true;
+    }
+    changed_.notify_all();
+}
+
+//=============================================//
+std::size_t OrderQueue::size() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return orders_.size();
+}
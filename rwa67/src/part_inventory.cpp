@@ -0,0 +1,72 @@
+#include "part_inventory.hpp"
+
+#include <cmath>
+
+//=============================================//
+int PartInventory::slot_(uint8_t type, uint8_t color)
+{
+    int type_index = static_cast<int>(type) - ariac_msgs::msg::Part::BATTERY;
+    int color_index = static_cast<int>(color) - ariac_msgs::msg::Part::RED;
+
+    if (type_index < 0 || type_index >= static_cast<int>(TYPE_COUNT) ||
+        color_index < 0 || color_index >= static_cast<int>(COLOR_COUNT))
+        return -1;
+
+    return type_index * static_cast<int>(COLOR_COUNT) + color_index;
+}
+
+//=============================================//
+void PartInventory::clear()
+{
+    for (auto &slot : slots_)
+        slot.clear();
+    size_ = 0;
+}
+
+//=============================================//
+void PartInventory::add(const ariac_msgs::msg::Part &part, const geometry_msgs::msg::Pose &world_pose)
+{
+    int slot = slot_(part.type, part.color);
+    if (slot < 0)
+        return;
+
+    slots_[slot].push_back(world_pose);
+    size_++;
+}
+
+//=============================================//
+const std::vector<geometry_msgs::msg::Pose> &PartInventory::parts(uint8_t type, uint8_t color) const
+{
+    static const std::vector<geometry_msgs::msg::Pose> none;
+
+    int slot = slot_(type, color);
+    if (slot < 0)
+        return none;
+
+    return slots_[slot];
+}
+
+//=============================================//
+bool PartInventory::nearest(uint8_t type, uint8_t color, double rail_position,
+                            geometry_msgs::msg::Pose &pose, double &distance) const
+{
+    bool found = false;
+    for (auto const &candidate : parts(type, color))
+    {
+        double candidate_distance = std::abs(-candidate.position.y - rail_position);
+        if (!found || candidate_distance < distance)
+        {
+            pose = candidate;
+            distance = candidate_distance;
+            found = true;
+        }
+    }
+
+    return found;
+}
+
+//=============================================//
+std::size_t PartInventory::size() const
+{
+    return size_;
+}
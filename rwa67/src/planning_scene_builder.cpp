@@ -0,0 +1,95 @@
+#include "planning_scene_builder.hpp"
+
+//=============================================//
+PlanningSceneBuilder::PlanningSceneBuilder(const std::string &frame_id)
+    : frame_id_(frame_id)
+{
+}
+
+//=============================================//
+moveit_msgs::msg::CollisionObject &PlanningSceneBuilder::stage_(
+    const std::string &id, const geometry_msgs::msg::Pose &pose)
+{
+    collision_objects_.emplace_back();
+
+    auto &collision = collision_objects_.back();
+    collision.id = id;
+    collision.header.frame_id = frame_id_;
+    collision.pose = pose;
+
+    return collision;
+}
+
+//=============================================//
+void PlanningSceneBuilder::add_mesh(
+    const std::string &id, const shape_msgs::msg::Mesh &mesh, const geometry_msgs::msg::Pose &pose)
+{
+    auto &collision = stage_(id, pose);
+
+    geometry_msgs::msg::Pose identity;
+    identity.orientation.w = 1.0;
+
+    collision.meshes.push_back(mesh);
+    collision.mesh_poses.push_back(identity);
+    collision.operation = collision.ADD;
+}
+
+//=============================================//
+void PlanningSceneBuilder::add_primitives(
+    const std::string &id, const std::vector<shape_msgs::msg::SolidPrimitive> &primitives,
+    const std::vector<geometry_msgs::msg::Pose> &primitive_poses, const geometry_msgs::msg::Pose &pose)
+{
+    auto &collision = stage_(id, pose);
+
+    collision.primitives = primitives;
+    collision.primitive_poses = primitive_poses;
+    collision.operation = collision.ADD;
+}
+
+//=============================================//
+void PlanningSceneBuilder::move(const std::string &id, const geometry_msgs::msg::Pose &pose)
+{
+    auto &collision = stage_(id, pose);
+    collision.operation = collision.MOVE;
+}
+
+//=============================================//
+void PlanningSceneBuilder::remove(const std::string &id)
+{
+    auto &collision = stage_(id, geometry_msgs::msg::Pose());
+    collision.operation = collision.REMOVE;
+}
+
+//=============================================//
+const std::vector<moveit_msgs::msg::CollisionObject> &PlanningSceneBuilder::collision_objects() const
+{
+    return collision_objects_;
+}
+
+//=============================================//
+moveit_msgs::msg::PlanningScene PlanningSceneBuilder::build() const
+{
+    moveit_msgs::msg::PlanningScene scene;
+    scene.is_diff = true;
+    scene.world.collision_objects = collision_objects_;
+
+    return scene;
+}
+
+//=============================================//
+bool PlanningSceneBuilder::empty() const
+{
+    return collision_objects_.empty();
+}
+
+//=============================================//
+std::size_t PlanningSceneBuilder::size() const
+{
+    return collision_objects_.size();
+}
+
+//=============================================//
+void PlanningSceneBuilder::clear()
+{
+    collision_objects_.clear();
+}
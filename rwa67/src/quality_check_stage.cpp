@@ -0,0 +1,93 @@
+#include "quality_check_stage.hpp"
+
+#include <algorithm>
+#include <chrono>
+
+//=============================================//
+QualityCheckStage::QualityCheckStage(rclcpp::Client<ariac_msgs::srv::PerformQualityCheck>::SharedPtr client)
+    : client_(std::move(client))
+{
+}
+
+//=============================================//
+void QualityCheckStage::start(const std::string &order_id, const ariac_msgs::msg::KittingTask &task)
+{
+    uint64_t check;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        check = ++checks_;
+        verdicts_[order_id] = Verdict{check, false, false};
+    }
+
+    std::map<int, ariac_msgs::msg::Part> parts;
+    for (auto const &kit_part : task.parts)
+        parts[kit_part.quadrant] = kit_part.part;
+
+    auto request = std::make_shared<ariac_msgs::srv::PerformQualityCheck::Request>();
+    request->order_id = order_id;
+    client_->async_send_request(
+        request,
+        [this, check, order_id, agv_num = static_cast<int>(task.agv_number), parts](
+            rclcpp::Client<ariac_msgs::srv::PerformQualityCheck>::SharedFuture future)
+        { done_(check, order_id, agv_num, parts, future); });
+}
+
+//=============================================//
+void QualityCheckStage::done_(uint64_t check, const std::string &order_id, int agv_num,
+                              const std::map<int, ariac_msgs::msg::Part> &parts,
+                              rclcpp::Client<ariac_msgs::srv::PerformQualityCheck>::SharedFuture future)
+{
+    auto response = future.get();
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto &verdict = verdicts_[order_id];
+        // the order was checked again since
+        if (verdict.check != check)
+            return;
+
+        verdict.done = true;
+        verdict.all_passed = response->all_passed;
+
+        int quadrant = 1;
+        for (auto const &issue : {response->quadrant1, response->quadrant2, response->quadrant3, response->quadrant4})
+        {
+            auto part = parts.find(quadrant);
+            if (issue.faulty_part && part != parts.end())
+                faulty_.push_back(FaultyPart{order_id, agv_num, quadrant, part->second});
+            quadrant++;
+        }
+    }
+    changed_.notify_all();
+}
+
+//=============================================//
+WaitResult QualityCheckStage::wait(const std::string &order_id, double timeout, bool &all_passed) const
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    bool done = changed_.wait_for(lock, std::chrono::duration<double>(timeout),
+                                  [this, &order_id]()
+                                  {
+                                      auto verdict = verdicts_.find(order_id);
+                                      return verdict != verdicts_.end() && verdict->second.done;
+                                  });
+    if (!done)
+        return WaitResult::TIMEOUT;
+
+    all_passed = verdicts_.at(order_id).all_passed;
+    return WaitResult::READY;
+}
+
+//=============================================//
+std::vector<FaultyPart> QualityCheckStage::take_faulty(const std::string &order_id)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<FaultyPart> taken;
+    auto of_order = std::stable_partition(faulty_.begin(), faulty_.end(),
+                                          [&order_id](const FaultyPart &part)
+                                          { return part.order_id != order_id; });
+    taken.assign(of_order, faulty_.end());
+    faulty_.erase(of_order, faulty_.end());
+
+    return taken;
+}
@@ -0,0 +1,174 @@
+#include "scene_object_manager.hpp"
+
+#include <sstream>
+
+namespace
+{
+    const char *state_name(SceneObjectState state)
+    {
+        switch (state)
+        {
+        case SceneObjectState::ADDED:
+            return "added";
+        case SceneObjectState::ATTACHED:
+            return "attached";
+        case SceneObjectState::DETACHED:
+            return "detached";
+        case SceneObjectState::REMOVED:
+            return "removed";
+        }
+        return "unknown";
+    }
+} // namespace
+
+//=============================================//
+SceneObjectManager::SceneObjectManager(const MeshRegistry &mesh_registry)
+    : mesh_registry_(mesh_registry)
+{
+}
+
+//=============================================//
+std::string SceneObjectManager::add(
+    PlanningSceneBuilder &builder, const std::string &kind, const std::string &mesh_file,
+    const geometry_msgs::msg::Pose &pose)
+{
+    auto mesh = mesh_registry_.get(mesh_file);
+    if (!mesh)
+        return "";
+
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    auto id = kind + "#" + std::to_string(++sequence_[kind]);
+    objects_[id] = SceneObject{kind, SceneObjectState::ADDED, ""};
+    added_++;
+
+    builder.add_mesh(id, *mesh, pose);
+    return id;
+}
+
+//=============================================//
+bool SceneObjectManager::attach(const std::string &id)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    auto it = objects_.find(id);
+    if (it == objects_.end())
+        return false;
+
+    it->second.state = SceneObjectState::ATTACHED;
+    it->second.location.clear();
+    return true;
+}
+
+//=============================================//
+bool SceneObjectManager::detach(const std::string &id, const std::string &location)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    auto it = objects_.find(id);
+    if (it == objects_.end() || it->second.state != SceneObjectState::ATTACHED)
+        return false;
+
+    it->second.state = SceneObjectState::DETACHED;
+    it->second.location = location;
+    return true;
+}
+
+//=============================================//
+std::string SceneObjectManager::find(const std::string &kind, const std::string &location) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    for (auto const &object : objects_)
+    {
+        if (object.second.state == SceneObjectState::DETACHED &&
+            object.second.kind == kind && object.second.location == location)
+            return object.first;
+    }
+
+    return "";
+}
+
+//=============================================//
+void SceneObjectManager::remove_(
+    PlanningSceneBuilder &builder, std::map<std::string, SceneObject>::iterator it)
+{
+    builder.remove(it->first);
+    objects_.erase(it);
+    removed_++;
+}
+
+//=============================================//
+bool SceneObjectManager::remove(PlanningSceneBuilder &builder, const std::string &id)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    auto it = objects_.find(id);
+    if (it == objects_.end() || it->second.state == SceneObjectState::ATTACHED)
+        return false;
+
+    remove_(builder, it);
+    return true;
+}
+
+//=============================================//
+std::size_t SceneObjectManager::collect(PlanningSceneBuilder &builder, const std::string &area)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    std::size_t collected = 0;
+    for (auto it = objects_.begin(); it != objects_.end();)
+    {
+        auto next = std::next(it);
+        auto const &location = it->second.location;
+
+        if (it->second.state == SceneObjectState::DETACHED &&
+            location.compare(0, area.size(), area) == 0 &&
+            (location.size() == area.size() || location[area.size()] == '/'))
+        {
+            remove_(builder, it);
+            collected++;
+        }
+        it = next;
+    }
+
+    return collected;
+}
+
+//=============================================//
+SceneObjectState SceneObjectManager::state(const std::string &id) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    auto it = objects_.find(id);
+    if (it == objects_.end())
+        return SceneObjectState::REMOVED;
+
+    return it->second.state;
+}
+
+//=============================================//
+std::size_t SceneObjectManager::live_count() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return objects_.size();
+}
+
+//=============================================//
+std::string SceneObjectManager::report() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    std::stringstream report;
+    report << "live: " << objects_.size() << ", added: " << added_ << ", removed: " << removed_;
+
+    for (auto const &object : objects_)
+    {
+        report << "\n"
+               << object.first << ": " << state_name(object.second.state);
+        if (!object.second.location.empty())
+            report << " at " << object.second.location;
+    }
+
+    return report.str();
+}
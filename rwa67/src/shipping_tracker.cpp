@@ -0,0 +1,103 @@
+#include "shipping_tracker.hpp"
+
+#include <algorithm>
+#include <chrono>
+
+#include <ariac_msgs/msg/agv_status.hpp>
+
+//=============================================//
+ShippingTracker::ShippingTracker(AgvLocations &agv_locations, SubmitFunction submit, ReportFunction report)
+    : agv_locations_(agv_locations), submit_(std::move(submit)), report_(std::move(report))
+{
+}
+
+//=============================================//
+ShippingTracker::~ShippingTracker()
+{
+    cancel();
+}
+
+//=============================================//
+void ShippingTracker::track(const std::string &order_id, int agv_num, double timeout)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    reap_finished_();
+    shipping_.push_back(agv_num);
+    workers_.emplace_back(&ShippingTracker::ship_, this, order_id, agv_num, timeout);
+}
+
+//=============================================//
+void ShippingTracker::reap_finished_()
+{
+    // a finished worker no longer needs the mutex, joining it here does not block for long
+    for (auto id : finished_)
+    {
+        auto worker = std::find_if(workers_.begin(), workers_.end(), [id](const std::thread &thread)
+                                   { return thread.get_id() == id; });
+        if (worker == workers_.end())
+            continue;
+        worker->join();
+        workers_.erase(worker);
+    }
+    finished_.clear();
+}
+
+//=============================================//
+void ShippingTracker::ship_(std::string order_id, int agv_num, double timeout)
+{
+    bool submitted = false;
+    if (agv_locations_.wait_for(agv_num, ariac_msgs::msg::AGVStatus::WAREHOUSE, timeout) == WaitResult::READY)
+        submitted = submit_(order_id);
+
+    report_(order_id, agv_num, submitted);
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        shipping_.erase(std::find(shipping_.begin(), shipping_.end(), agv_num));
+        finished_.push_back(std::this_thread::get_id());
+    }
+    changed_.notify_all();
+}
+
+//=============================================//
+bool ShippingTracker::wait_shipped(int agv_num, double timeout) const
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    return changed_.wait_for(lock, std::chrono::duration<double>(timeout),
+                             [this, agv_num]()
+                             { return std::find(shipping_.begin(), shipping_.end(), agv_num) == shipping_.end(); });
+}
+
+//=============================================//
+bool ShippingTracker::wait_all(double timeout) const
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    return changed_.wait_for(lock, std::chrono::duration<double>(timeout),
+                             [this]()
+                             { return shipping_.empty(); });
+}
+
+//=============================================//
+std::size_t ShippingTracker::pending() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return shipping_.size();
+}
+
+//=============================================//
+void ShippingTracker::cancel()
+{
+    agv_locations_.cancel();
+
+    std::vector<std::thread> workers;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        workers.swap(workers_);
+        finished_.clear();
+    }
+    for (auto &worker : workers)
+    {
+        if (worker.joinable())
+            worker.join();
+    }
+}
@@ -0,0 +1,140 @@
+#include "trajectory_cache.hpp"
+
+#include <cmath>
+
+TrajectoryCache::TrajectoryCache(std::size_t capacity,
+                                 double joint_resolution,
+                                 double position_resolution,
+                                 double orientation_resolution,
+                                 double scaling_resolution)
+    : capacity_(capacity),
+      joint_resolution_(joint_resolution),
+      position_resolution_(position_resolution),
+      orientation_resolution_(orientation_resolution),
+      scaling_resolution_(scaling_resolution)
+{
+}
+
+//=============================================//
+void TrajectoryCache::append_quantized_(std::string &key, double value, double resolution)
+{
+    int64_t q = static_cast<int64_t>(std::llround(value / resolution));
+    key.append(reinterpret_cast<const char *>(&q), sizeof(q));
+}
+
+//=============================================//
+void TrajectoryCache::make_key(const std::vector<double> &start_joints,
+                               const std::vector<geometry_msgs::msg::Pose> &waypoints,
+                               double vsf, double asf, std::string &key) const
+{
+    key.clear();
+    key.reserve((start_joints.size() + 7 * waypoints.size() + 2) * sizeof(int64_t));
+
+    for (auto joint : start_joints)
+        append_quantized_(key, joint, joint_resolution_);
+
+    for (auto const &pose : waypoints)
+    {
+        append_quantized_(key, pose.position.x, position_resolution_);
+        append_quantized_(key, pose.position.y, position_resolution_);
+        append_quantized_(key, pose.position.z, position_resolution_);
+
+        // q and -q describe the same orientation
+        double sign = pose.orientation.w < 0 ? -1.0 : 1.0;
+        append_quantized_(key, sign * pose.orientation.x, orientation_resolution_);
+        append_quantized_(key, sign * pose.orientation.y, orientation_resolution_);
+        append_quantized_(key, sign * pose.orientation.z, orientation_resolution_);
+        append_quantized_(key, sign * pose.orientation.w, orientation_resolution_);
+    }
+
+    append_quantized_(key, vsf, scaling_resolution_);
+    append_quantized_(key, asf, scaling_resolution_);
+}
+
+//=============================================//
+bool TrajectoryCache::lookup(const std::string &key, moveit_msgs::msg::RobotTrajectory &trajectory)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    auto it = entries_.find(key);
+    if (it == entries_.end())
+    {
+        stats_.misses++;
+        return false;
+    }
+
+    // mark as most recently used
+    lru_.splice(lru_.begin(), lru_, it->second.lru_it);
+
+    stats_.hits++;
+    stats_.saved_planning_time += it->second.planning_time;
+    trajectory = it->second.trajectory;
+    return true;
+}
+
+//=============================================//
+void TrajectoryCache::insert(const std::string &key, const moveit_msgs::msg::RobotTrajectory &trajectory, double planning_time)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (capacity_ == 0)
+        return;
+
+    auto it = entries_.find(key);
+    if (it != entries_.end())
+    {
+        it->second.trajectory = trajectory;
+        it->second.planning_time = planning_time;
+        lru_.splice(lru_.begin(), lru_, it->second.lru_it);
+        return;
+    }
+
+    if (entries_.size() >= capacity_)
+    {
+        entries_.erase(lru_.back());
+        lru_.pop_back();
+    }
+
+    lru_.push_front(key);
+    entries_[key] = Entry{trajectory, planning_time, lru_.begin()};
+}
+
+//=============================================//
+void TrajectoryCache::reject(const std::string &key)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    auto it = entries_.find(key);
+    if (it == entries_.end())
+        return;
+
+    stats_.hits--;
+    stats_.saved_planning_time -= it->second.planning_time;
+    stats_.misses++;
+    stats_.rejected++;
+
+    lru_.erase(it->second.lru_it);
+    entries_.erase(it);
+}
+
+//=============================================//
+void TrajectoryCache::clear()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    entries_.clear();
+    lru_.clear();
+}
+
+//=============================================//
+TrajectoryCache::Stats TrajectoryCache::stats() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+//=============================================//
+std::size_t TrajectoryCache::size() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return entries_.size();
+}
@@ -0,0 +1,212 @@
+#include "vertical_move_generator.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#include <Eigen/SVD>
+
+VerticalMoveGenerator::VerticalMoveGenerator(const moveit::core::JointModelGroup *group,
+                                             const std::string &tip_link,
+                                             double eef_step,
+                                             double position_tolerance,
+                                             double orientation_tolerance,
+                                             double min_conditioning,
+                                             double max_joint_step,
+                                             double ik_timeout)
+    : group_(group),
+      tip_link_(tip_link),
+      eef_step_(eef_step),
+      position_tolerance_(position_tolerance),
+      orientation_tolerance_(orientation_tolerance),
+      min_conditioning_(min_conditioning),
+      max_joint_step_(max_joint_step),
+      ik_timeout_(ik_timeout)
+{
+}
+
+//=============================================//
+Eigen::Isometry3d VerticalMoveGenerator::to_isometry_(const geometry_msgs::msg::Pose &pose)
+{
+    Eigen::Isometry3d isometry = Eigen::Isometry3d::Identity();
+    isometry.translation() = Eigen::Vector3d(pose.position.x, pose.position.y, pose.position.z);
+    isometry.linear() = Eigen::Quaterniond(pose.orientation.w, pose.orientation.x,
+                                           pose.orientation.y, pose.orientation.z)
+                            .normalized()
+                            .toRotationMatrix();
+    return isometry;
+}
+
+//=============================================//
+bool VerticalMoveGenerator::is_close_(const Eigen::Isometry3d &pose1, const Eigen::Isometry3d &pose2) const
+{
+    if ((pose1.translation() - pose2.translation()).norm() > position_tolerance_)
+        return false;
+
+    Eigen::Quaterniond q1(pose1.linear());
+    Eigen::Quaterniond q2(pose2.linear());
+    return q1.angularDistance(q2) <= orientation_tolerance_;
+}
+
+//=============================================//
+bool VerticalMoveGenerator::is_well_conditioned_(moveit::core::RobotState &state, const std::vector<double> &joint_values) const
+{
+    state.setJointGroupPositions(group_, joint_values);
+    state.updateLinkTransforms();
+
+    Eigen::MatrixXd jacobian;
+    if (!state.getJacobian(group_, state.getLinkModel(tip_link_), Eigen::Vector3d::Zero(), jacobian))
+        return false;
+
+    Eigen::JacobiSVD<Eigen::MatrixXd> svd(jacobian);
+    auto const &singular_values = svd.singularValues();
+    if (singular_values.size() == 0 || singular_values(0) <= 0.0)
+        return false;
+
+    return singular_values(singular_values.size() - 1) >= min_conditioning_ * singular_values(0);
+}
+
+//=============================================//
+Eigen::Isometry3d VerticalMoveGenerator::forward_kinematics_(moveit::core::RobotState &state, const std::vector<double> &joint_values) const
+{
+    state.setJointGroupPositions(group_, joint_values);
+    state.updateLinkTransforms();
+    return state.getGlobalLinkTransform(tip_link_);
+}
+
+//=============================================//
+bool VerticalMoveGenerator::solve_ik_(moveit::core::RobotState &state, const Eigen::Isometry3d &pose,
+                                      const std::vector<double> &seed, std::vector<double> &joint_values, Result &result) const
+{
+    // setFromIK seeds the solver with the current values of the state
+    state.setJointGroupPositions(group_, seed);
+    result.ik_calls++;
+    if (!state.setFromIK(group_, pose, tip_link_, ik_timeout_))
+        return false;
+
+    state.copyJointGroupPositions(group_, joint_values);
+    return true;
+}
+
+//=============================================//
+bool VerticalMoveGenerator::fill_span_(moveit::core::RobotState &state, const std::vector<Eigen::Isometry3d> &samples,
+                                       std::vector<std::vector<double>> &solutions, std::size_t lo, std::size_t hi, Result &result) const
+{
+    const std::vector<double> &q_lo = solutions[lo];
+    const std::vector<double> &q_hi = solutions[hi];
+    double span = static_cast<double>(hi - lo);
+
+    auto interpolate = [&q_lo, &q_hi](double t)
+    {
+        std::vector<double> q(q_lo.size());
+        for (std::size_t j = 0; j < q.size(); j++)
+            q[j] = q_lo[j] + t * (q_hi[j] - q_lo[j]);
+        return q;
+    };
+
+    double max_step = 0.0;
+    for (std::size_t j = 0; j < q_lo.size(); j++)
+        max_step = std::max(max_step, std::fabs(q_hi[j] - q_lo[j]) / span);
+
+    if (hi - lo == 1)
+        return max_step <= max_joint_step_;
+
+    // Interpolate in joint space as long as every sample stays on the line
+    if (max_step <= max_joint_step_ && is_well_conditioned_(state, q_lo) && is_well_conditioned_(state, q_hi))
+    {
+        bool on_line = true;
+        for (std::size_t k = lo + 1; k < hi && on_line; k++)
+        {
+            solutions[k] = interpolate(static_cast<double>(k - lo) / span);
+            on_line = is_close_(forward_kinematics_(state, solutions[k]), samples[k]);
+        }
+
+        if (on_line)
+        {
+            result.interpolated_samples += hi - lo - 1;
+            return true;
+        }
+    }
+
+    // Otherwise solve the middle sample and refine both halves
+    std::size_t mid = lo + (hi - lo) / 2;
+    if (!solve_ik_(state, samples[mid], interpolate(static_cast<double>(mid - lo) / span), solutions[mid], result))
+        return false;
+
+    return fill_span_(state, samples, solutions, lo, mid, result) &&
+           fill_span_(state, samples, solutions, mid, hi, result);
+}
+
+//=============================================//
+bool VerticalMoveGenerator::is_vertical(const moveit::core::RobotState &start_state,
+                                        const std::vector<geometry_msgs::msg::Pose> &waypoints) const
+{
+    if (waypoints.empty())
+        return false;
+
+    moveit::core::RobotState state(start_state);
+    state.updateLinkTransforms();
+    Eigen::Isometry3d previous = state.getGlobalLinkTransform(tip_link_);
+    for (auto const &waypoint : waypoints)
+    {
+        Eigen::Isometry3d target = to_isometry_(waypoint);
+        if (std::fabs(target.translation().x() - previous.translation().x()) > position_tolerance_ ||
+            std::fabs(target.translation().y() - previous.translation().y()) > position_tolerance_)
+            return false;
+
+        if (Eigen::Quaterniond(target.linear()).angularDistance(Eigen::Quaterniond(previous.linear())) > orientation_tolerance_)
+            return false;
+
+        previous = target;
+    }
+
+    return true;
+}
+
+//=============================================//
+bool VerticalMoveGenerator::generate(const moveit::core::RobotState &start_state,
+                                     const std::vector<geometry_msgs::msg::Pose> &waypoints,
+                                     Result &result) const
+{
+    result = Result();
+
+    if (!is_vertical(start_state, waypoints))
+        return false;
+
+    moveit::core::RobotState state(start_state);
+    state.updateLinkTransforms();
+
+    std::vector<double> current;
+    state.copyJointGroupPositions(group_, current);
+    result.path.push_back(current);
+
+    Eigen::Isometry3d previous = state.getGlobalLinkTransform(tip_link_);
+    for (auto const &waypoint : waypoints)
+    {
+        Eigen::Isometry3d target = to_isometry_(waypoint);
+
+        double distance = (target.translation() - previous.translation()).norm();
+        std::size_t steps = std::max<std::size_t>(1, static_cast<std::size_t>(std::ceil(distance / eef_step_)));
+
+        // Samples along the segment, at the orientation of the waypoint
+        std::vector<Eigen::Isometry3d> samples(steps + 1, target);
+        for (std::size_t k = 0; k <= steps; k++)
+        {
+            double t = static_cast<double>(k) / static_cast<double>(steps);
+            samples[k].translation() = previous.translation() + t * (target.translation() - previous.translation());
+        }
+
+        std::vector<std::vector<double>> solutions(steps + 1);
+        solutions[0] = current;
+        if (!solve_ik_(state, samples[steps], current, solutions[steps], result))
+            return false;
+
+        if (!fill_span_(state, samples, solutions, 0, steps, result))
+            return false;
+
+        result.path.insert(result.path.end(), solutions.begin() + 1, solutions.end());
+        current = solutions[steps];
+        previous = target;
+    }
+
+    return true;
+}
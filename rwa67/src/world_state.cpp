@@ -0,0 +1,143 @@
+#include "world_state.hpp"
+
+#include <algorithm>
+
+#include "utils.hpp"
+
+namespace
+{
+    const geometry_msgs::msg::Pose NO_POSE;
+    const std::vector<ariac_msgs::msg::PartPose> NO_PARTS;
+    const std::vector<ariac_msgs::msg::KitTrayPose> NO_TRAYS;
+} // namespace
+
+//=============================================//
+const geometry_msgs::msg::Pose &CameraView::sensor_pose() const
+{
+    return image ? image->sensor_pose : NO_POSE;
+}
+
+//=============================================//
+const std::vector<ariac_msgs::msg::PartPose> &CameraView::parts() const
+{
+    return image ? image->part_poses : NO_PARTS;
+}
+
+//=============================================//
+const std::vector<ariac_msgs::msg::KitTrayPose> &CameraView::trays() const
+{
+    return image ? image->tray_poses : NO_TRAYS;
+}
+
+//=============================================//
+bool WorldSnapshot::nearest_bin_part(uint8_t type, uint8_t color, double rail_position,
+                                     geometry_msgs::msg::Pose &pose, WorldCamera &camera) const
+{
+    bool found = false;
+    double best_distance = 0.0;
+    for (auto bins : {WorldCamera::LEFT_BINS, WorldCamera::RIGHT_BINS})
+    {
+        geometry_msgs::msg::Pose candidate;
+        double distance;
+        if (this->camera(bins).inventory.nearest(type, color, rail_position, candidate, distance) &&
+            (!found || distance < best_distance))
+        {
+            pose = candidate;
+            camera = bins;
+            best_distance = distance;
+            found = true;
+        }
+    }
+
+    return found;
+}
+
+//=============================================//
+WorldState::WorldState()
+{
+    for (std::size_t i = 0; i < WorldSnapshot::CAMERA_COUNT; i++)
+    {
+        front_[i] = std::make_shared<CameraView>();
+        back_[i] = std::make_shared<CameraView>();
+    }
+}
+
+//=============================================//
+uint64_t WorldState::publish(WorldCamera camera, ariac_msgs::msg::AdvancedLogicalCameraImage::ConstSharedPtr image)
+{
+    auto index = static_cast<std::size_t>(camera);
+    auto &back = back_[index];
+
+    // a reader still holds the previous front frame, write a new one
+    if (back.use_count() > 1)
+        back = std::make_shared<CameraView>();
+
+    back->stamp = std::chrono::steady_clock::now();
+    back->image = std::move(image);
+
+    auto const &sensor_pose = back->image->sensor_pose;
+    back->inventory.clear();
+    for (auto const &part : back->image->part_poses)
+        back->inventory.add(part.part, Utils::multiply_poses(sensor_pose, part.pose));
+
+    bytes_shared_ += sizeof(geometry_msgs::msg::Pose) +
+                     back->image->part_poses.size() * sizeof(ariac_msgs::msg::PartPose) +
+                     back->image->tray_poses.size() * sizeof(ariac_msgs::msg::KitTrayPose);
+    bytes_copied_ += back->image->part_poses.size() * sizeof(geometry_msgs::msg::Pose);
+
+    auto stamp = back->stamp.time_since_epoch().count();
+    int64_t no_stamp = 0;
+    first_stamp_.compare_exchange_strong(no_stamp, stamp);
+    last_stamp_ = stamp;
+
+    back->sequence = sequence_.fetch_add(1) + 1;
+
+    auto sequence = back->sequence;
+    CameraViewConstPtr published = std::move(back);
+    auto previous = std::atomic_exchange(&front_[index], published);
+
+    // every frame is created non-const by this class
+    back = std::const_pointer_cast<CameraView>(previous);
+
+    return sequence;
+}
+
+//=============================================//
+CameraViewConstPtr WorldState::camera(WorldCamera camera) const
+{
+    return std::atomic_load(&front_[static_cast<std::size_t>(camera)]);
+}
+
+//=============================================//
+WorldSnapshot WorldState::snapshot() const
+{
+    WorldSnapshot snapshot;
+    for (std::size_t i = 0; i < WorldSnapshot::CAMERA_COUNT; i++)
+    {
+        snapshot.cameras[i] = std::atomic_load(&front_[i]);
+        snapshot.sequence = std::max(snapshot.sequence, snapshot.cameras[i]->sequence);
+    }
+
+    return snapshot;
+}
+
+//=============================================//
+uint64_t WorldState::sequence() const
+{
+    return sequence_.load();
+}
+
+//=============================================//
+WorldStateStats WorldState::stats() const
+{
+    WorldStateStats stats;
+    stats.frames = sequence_.load();
+    stats.bytes_shared = bytes_shared_.load();
+    stats.bytes_copied = bytes_copied_.load();
+    if (stats.frames > 0)
+        stats.seconds = std::chrono::duration<double>(
+                            std::chrono::steady_clock::duration(last_stamp_.load() - first_stamp_.load()))
+                            .count();
+
+    return stats;
+}
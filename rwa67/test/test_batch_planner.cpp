@@ -0,0 +1,240 @@
+#include <gtest/gtest.h>
+
+#include "batch_planner.hpp"
+
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace
+{
+    constexpr double KTS1 = 4.0;
+    constexpr double KTS2 = -4.0;
+
+    //! Camera frame with the sensor at the origin, so that the poses are world poses
+    ariac_msgs::msg::AdvancedLogicalCameraImage::ConstSharedPtr make_image(
+        const std::vector<std::pair<ariac_msgs::msg::Part, double>> &parts, const std::vector<uint8_t> &tray_ids = {})
+    {
+        auto image = std::make_shared<ariac_msgs::msg::AdvancedLogicalCameraImage>();
+        image->sensor_pose.orientation.w = 1.0;
+        for (auto const &part : parts)
+        {
+            ariac_msgs::msg::PartPose part_pose;
+            part_pose.part = part.first;
+            // the rail position of a part is -y
+            part_pose.pose.position.y = -part.second;
+            part_pose.pose.orientation.w = 1.0;
+            image->part_poses.push_back(part_pose);
+        }
+        for (auto tray_id : tray_ids)
+        {
+            ariac_msgs::msg::KitTrayPose tray;
+            tray.id = tray_id;
+            tray.pose.orientation.w = 1.0;
+            image->tray_poses.push_back(tray);
+        }
+        return image;
+    }
+
+    ariac_msgs::msg::Part make_part(uint8_t type, uint8_t color)
+    {
+        ariac_msgs::msg::Part part;
+        part.type = type;
+        part.color = color;
+        return part;
+    }
+
+    BatchJob make_job(const std::string &order_id, const ariac_msgs::msg::Part &part, double place_position,
+                      bool priority = false)
+    {
+        BatchJob job;
+        job.order_id = order_id;
+        job.priority = priority;
+        job.part = part;
+        job.place_position = place_position;
+        return job;
+    }
+
+    BatchJob make_tray_job(const std::string &order_id, int tray_id, double place_position, bool priority = false)
+    {
+        BatchJob job;
+        job.order_id = order_id;
+        job.priority = priority;
+        job.gripper = "tray_gripper";
+        job.tray_id = tray_id;
+        job.place_position = place_position;
+        return job;
+    }
+} // namespace
+
+//=============================================//
+TEST(RailCostModel, KeepsThePriorsUntilEnoughMoves)
+{
+    RailCostModel model(2.0, 1.0, 10.0);
+    EXPECT_DOUBLE_EQ(model.travel(1.0, 1.0), 0.0);
+    EXPECT_DOUBLE_EQ(model.travel(-1.0, 2.0), 5.0);
+    EXPECT_DOUBLE_EQ(model.gripper_change(), 10.0);
+
+    // 1 s + 0.5 s/m, but only four moves
+    for (double distance : {1.0, 2.0, 3.0, 4.0})
+        model.record(distance, 1.0 + 0.5 * distance);
+    EXPECT_EQ(model.samples(), 4u);
+    EXPECT_DOUBLE_EQ(model.travel(0.0, 3.0), 5.0);
+}
+
+//=============================================//
+TEST(RailCostModel, FitsTheRecordedMoves)
+{
+    RailCostModel model(2.0, 1.0, 10.0);
+    for (double distance : {1.0, 2.0, 3.0, 4.0, 5.0})
+        model.record(distance, 1.0 + 0.5 * distance);
+
+    EXPECT_NEAR(model.travel(0.0, 3.0), 2.5, 1e-9);
+    EXPECT_NEAR(model.travel(2.0, 0.0), 2.0, 1e-9);
+}
+
+//=============================================//
+TEST(RailCostModel, IgnoresMovesOfTheSameLength)
+{
+    RailCostModel model(2.0, 1.0, 10.0);
+    for (int i = 0; i < 10; i++)
+        model.record(2.0, 3.0 + 0.01 * i);
+
+    // the fixed time and the time per meter cannot be told apart
+    EXPECT_DOUBLE_EQ(model.travel(0.0, 3.0), 5.0);
+}
+
+//=============================================//
+TEST(RailCostModel, RejectsANonPhysicalFit)
+{
+    RailCostModel model(2.0, 1.0, 10.0);
+    for (double distance : {1.0, 2.0, 3.0, 4.0, 5.0})
+        model.record(distance, 6.0 - distance);
+
+    EXPECT_DOUBLE_EQ(model.travel(0.0, 3.0), 5.0);
+}
+
+//=============================================//
+TEST(BatchPlanner, AssignsEachBinPartOnce)
+{
+    auto battery = make_part(ariac_msgs::msg::Part::BATTERY, ariac_msgs::msg::Part::RED);
+    WorldState world;
+    world.publish(WorldCamera::RIGHT_BINS, make_image({{battery, -3.0}, {battery, -2.5}}));
+
+    RailCostModel model(1.0, 1.0, 10.0);
+    BatchPlanner planner(model, KTS1, KTS2, false);
+
+    double seconds = 0.0;
+    auto steps = planner.plan({make_job("a", battery, -1.2), make_job("b", battery, -1.2)},
+                              world.snapshot(), 0.0, "part_gripper", seconds);
+    ASSERT_EQ(steps.size(), 2u);
+    EXPECT_TRUE(steps[0].located);
+    EXPECT_TRUE(steps[1].located);
+    EXPECT_NE(steps[0].pick_position, steps[1].pick_position);
+    EXPECT_GT(seconds, 0.0);
+}
+
+//=============================================//
+TEST(BatchPlanner, AssignsTheBinPartsOfTheSameRow)
+{
+    // the parts of a bin row share their rail position
+    auto battery = make_part(ariac_msgs::msg::Part::BATTERY, ariac_msgs::msg::Part::RED);
+    WorldState world;
+    world.publish(WorldCamera::RIGHT_BINS, make_image({{battery, -3.0}, {battery, -3.0}}));
+
+    RailCostModel model(1.0, 1.0, 10.0);
+    BatchPlanner planner(model, KTS1, KTS2, false);
+
+    double seconds = 0.0;
+    auto steps = planner.plan({make_job("a", battery, -1.2), make_job("b", battery, -1.2)},
+                              world.snapshot(), 0.0, "part_gripper", seconds);
+    ASSERT_EQ(steps.size(), 2u);
+    EXPECT_TRUE(steps[0].located);
+    EXPECT_TRUE(steps[1].located);
+    EXPECT_DOUBLE_EQ(steps[0].pick_position, -3.0);
+    EXPECT_DOUBLE_EQ(steps[1].pick_position, -3.0);
+}
+
+//=============================================//
+TEST(BatchPlanner, KeepsThePlacePositionOfAMissingPart)
+{
+    WorldState world;
+    RailCostModel model(1.0, 1.0, 10.0);
+    BatchPlanner planner(model, KTS1, KTS2, false);
+
+    double seconds = 0.0;
+    auto pump = make_part(ariac_msgs::msg::Part::PUMP, ariac_msgs::msg::Part::BLUE);
+    auto steps = planner.plan({make_job("a", pump, 1.2)}, world.snapshot(), 0.0, "part_gripper", seconds);
+    ASSERT_EQ(steps.size(), 1u);
+    EXPECT_FALSE(steps[0].located);
+    EXPECT_DOUBLE_EQ(steps[0].pick_position, 1.2);
+}
+
+//=============================================//
+TEST(BatchPlanner, PriorityJobsComeFirst)
+{
+    auto battery = make_part(ariac_msgs::msg::Part::BATTERY, ariac_msgs::msg::Part::RED);
+    auto sensor = make_part(ariac_msgs::msg::Part::SENSOR, ariac_msgs::msg::Part::GREEN);
+    WorldState world;
+    world.publish(WorldCamera::LEFT_BINS, make_image({{battery, 3.0}}));
+    world.publish(WorldCamera::RIGHT_BINS, make_image({{sensor, -3.0}}));
+
+    RailCostModel model(1.0, 1.0, 10.0);
+    BatchPlanner planner(model, KTS1, KTS2, false);
+
+    // the robot is next to the battery, the priority sensor still comes first
+    double seconds = 0.0;
+    auto steps = planner.plan({make_job("a", battery, 4.5), make_job("p", sensor, -4.5, true)},
+                              world.snapshot(), 3.0, "part_gripper", seconds);
+    ASSERT_EQ(steps.size(), 2u);
+    EXPECT_EQ(steps[0].job.order_id, "p");
+    EXPECT_EQ(steps[1].job.order_id, "a");
+}
+
+//=============================================//
+TEST(BatchPlanner, PlacesTheTrayBeforeThePartsOfItsKit)
+{
+    auto battery = make_part(ariac_msgs::msg::Part::BATTERY, ariac_msgs::msg::Part::RED);
+    WorldState world;
+    world.publish(WorldCamera::KTS1, make_image({}, {3}));
+    world.publish(WorldCamera::RIGHT_BINS, make_image({{battery, -3.0}}));
+
+    // a gripper change is cheap, the battery is next to the robot and the tray is far away
+    RailCostModel model(1.0, 1.0, 0.1);
+    BatchPlanner planner(model, KTS1, KTS2, false);
+
+    double seconds = 0.0;
+    auto steps = planner.plan({make_job("a", battery, -4.5), make_tray_job("a", 3, -4.5)},
+                              world.snapshot(), -3.0, "part_gripper", seconds);
+    ASSERT_EQ(steps.size(), 2u);
+    EXPECT_TRUE(steps[0].job.is_tray());
+    EXPECT_TRUE(steps[0].located);
+    EXPECT_DOUBLE_EQ(steps[0].pick_position, KTS1);
+    EXPECT_LT(seconds, 1e6);
+}
+
+//=============================================//
+TEST(BatchPlanner, TrayFirstPlacesAllTheTraysInOneSession)
+{
+    auto battery = make_part(ariac_msgs::msg::Part::BATTERY, ariac_msgs::msg::Part::RED);
+    auto sensor = make_part(ariac_msgs::msg::Part::SENSOR, ariac_msgs::msg::Part::GREEN);
+    WorldState world;
+    world.publish(WorldCamera::KTS1, make_image({}, {1}));
+    world.publish(WorldCamera::KTS2, make_image({}, {2}));
+    world.publish(WorldCamera::RIGHT_BINS, make_image({{battery, -3.0}, {sensor, -3.0}}));
+
+    RailCostModel model(1.0, 1.0, 10.0);
+    BatchPlanner planner(model, KTS1, KTS2, true);
+
+    // both trays first, the priority one leading, then the parts, the priority ones leading
+    double seconds = 0.0;
+    auto steps = planner.plan({make_job("a", battery, -4.5), make_tray_job("a", 1, -4.5),
+                               make_job("p", sensor, -1.2, true), make_tray_job("p", 2, -1.2, true)},
+                              world.snapshot(), 0.0, "part_gripper", seconds);
+    ASSERT_EQ(steps.size(), 4u);
+    EXPECT_TRUE(steps[0].job.is_tray());
+    EXPECT_EQ(steps[0].job.order_id, "p");
+    EXPECT_TRUE(steps[1].job.is_tray());
+    EXPECT_EQ(steps[2].job.order_id, "p");
+    EXPECT_FALSE(steps[3].job.is_tray());
+}
@@ -0,0 +1,113 @@
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <memory>
+#include <thread>
+
+#include <geometry_msgs/msg/transform_stamped.hpp>
+#include <rclcpp/rclcpp.hpp>
+
+#include "frame_pose_cache.hpp"
+
+class FramePoseCacheTest : public ::testing::Test
+{
+protected:
+    // tf2_ros::Buffer only waits for a transform while rclcpp is ok
+    static void SetUpTestSuite() { rclcpp::init(0, nullptr); }
+    static void TearDownTestSuite() { rclcpp::shutdown(); }
+
+    //! Publish a static frame at x along the world x axis
+    void set_frame(const std::string &frame, double x)
+    {
+        geometry_msgs::msg::TransformStamped transform;
+        transform.header.frame_id = "world";
+        transform.child_frame_id = frame;
+        transform.transform.translation.x = x;
+        transform.transform.rotation.w = 1.0;
+        buffer_.setTransform(transform, "test", true);
+    }
+
+    tf2_ros::Buffer buffer_{std::make_shared<rclcpp::Clock>()};
+    FramePoseCache cache_{buffer_};
+};
+
+//=============================================//
+TEST_F(FramePoseCacheTest, ServesTheCachedPoseUntilInvalidated)
+{
+    set_frame("agv1_tray", 1.0);
+    auto lookup = cache_.lookup("agv1_tray", 1.0);
+    ASSERT_TRUE(lookup);
+    EXPECT_FALSE(lookup.cached);
+    EXPECT_DOUBLE_EQ(lookup.pose->position.x, 1.0);
+
+    // the AGV moved, the cache does not know yet
+    set_frame("agv1_tray", 2.0);
+    lookup = cache_.lookup("agv1_tray", 1.0);
+    ASSERT_TRUE(lookup);
+    EXPECT_TRUE(lookup.cached);
+    EXPECT_DOUBLE_EQ(lookup.pose->position.x, 1.0);
+
+    cache_.invalidate("agv1_tray");
+    lookup = cache_.lookup("agv1_tray", 1.0);
+    ASSERT_TRUE(lookup);
+    EXPECT_FALSE(lookup.cached);
+    EXPECT_DOUBLE_EQ(lookup.pose->position.x, 2.0);
+
+    auto stats = cache_.stats();
+    EXPECT_EQ(stats.hits, 1u);
+    EXPECT_EQ(stats.lookups, 2u);
+    EXPECT_EQ(stats.failures, 0u);
+}
+
+//=============================================//
+TEST_F(FramePoseCacheTest, FailedLookupsAreNotCached)
+{
+    auto lookup = cache_.lookup("missing", 0.0);
+    EXPECT_FALSE(lookup);
+    EXPECT_NE(lookup.error, FrameLookupError::NONE);
+    EXPECT_FALSE(lookup.message.empty());
+
+    set_frame("missing", 1.0);
+    lookup = cache_.lookup("missing", 1.0);
+    ASSERT_TRUE(lookup);
+    EXPECT_FALSE(lookup.cached);
+    EXPECT_EQ(cache_.stats().failures, 1u);
+}
+
+//=============================================//
+TEST_F(FramePoseCacheTest, PoseLookedUpDuringAnInvalidationIsNotCached)
+{
+    // the lookup waits for the frame, without holding the lock of the cache
+    FrameLookup lookup;
+    std::thread waiter([this, &lookup]()
+                       { lookup = cache_.lookup("agv2_tray", 5.0); });
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    cache_.invalidate("agv2_tray");
+    set_frame("agv2_tray", 1.0);
+    waiter.join();
+
+    ASSERT_TRUE(lookup);
+    EXPECT_FALSE(lookup.cached);
+
+    // the pose may predate the invalidation, it is looked up again
+    lookup = cache_.lookup("agv2_tray", 1.0);
+    ASSERT_TRUE(lookup);
+    EXPECT_FALSE(lookup.cached);
+
+    lookup = cache_.lookup("agv2_tray", 1.0);
+    EXPECT_TRUE(lookup.cached);
+}
+
+//=============================================//
+TEST_F(FramePoseCacheTest, ClearDropsEveryPose)
+{
+    set_frame("kts1_tool_changer", 1.0);
+    set_frame("kts2_tool_changer", 2.0);
+    ASSERT_TRUE(cache_.lookup("kts1_tool_changer", 1.0));
+    ASSERT_TRUE(cache_.lookup("kts2_tool_changer", 1.0));
+
+    cache_.clear();
+    EXPECT_FALSE(cache_.lookup("kts1_tool_changer", 1.0).cached);
+    EXPECT_FALSE(cache_.lookup("kts2_tool_changer", 1.0).cached);
+}
@@ -0,0 +1,146 @@
+#include <gtest/gtest.h>
+
+#include "inventory_tracker.hpp"
+
+namespace
+{
+    //! Frame with the sensor at the origin, so that the poses are world poses
+    ariac_msgs::msg::AdvancedLogicalCameraImage make_image()
+    {
+        ariac_msgs::msg::AdvancedLogicalCameraImage image;
+        image.sensor_pose.orientation.w = 1.0;
+        return image;
+    }
+
+    void add_part(ariac_msgs::msg::AdvancedLogicalCameraImage &image, uint8_t type, uint8_t color, double x, double y)
+    {
+        ariac_msgs::msg::PartPose part;
+        part.part.type = type;
+        part.part.color = color;
+        part.pose.position.x = x;
+        part.pose.position.y = y;
+        part.pose.orientation.w = 1.0;
+        image.part_poses.push_back(part);
+    }
+
+    void add_tray(ariac_msgs::msg::AdvancedLogicalCameraImage &image, uint8_t tray_id, double x, double y)
+    {
+        ariac_msgs::msg::KitTrayPose tray;
+        tray.id = tray_id;
+        tray.pose.position.x = x;
+        tray.pose.position.y = y;
+        tray.pose.orientation.w = 1.0;
+        image.tray_poses.push_back(tray);
+    }
+
+    constexpr uint8_t BATTERY = ariac_msgs::msg::Part::BATTERY;
+    constexpr uint8_t RED = ariac_msgs::msg::Part::RED;
+} // namespace
+
+//=============================================//
+TEST(InventoryTracker, AddsNewObjectsWithUniqueIds)
+{
+    std::atomic<uint32_t> next_id{0};
+    InventoryTracker tracker(next_id, 0.1, 0.005);
+
+    auto image = make_image();
+    add_part(image, BATTERY, RED, 0.0, 0.0);
+    add_part(image, BATTERY, RED, 0.5, 0.0);
+    add_tray(image, 3, 1.0, 0.0);
+
+    custom_msgs::msg::InventoryDelta delta;
+    ASSERT_TRUE(tracker.update(image, delta));
+    ASSERT_EQ(delta.added.size(), 3u);
+    EXPECT_TRUE(delta.removed.empty());
+    EXPECT_TRUE(delta.moved.empty());
+    EXPECT_NE(delta.added[0].id, delta.added[1].id);
+    EXPECT_NE(delta.added[1].id, delta.added[2].id);
+    EXPECT_EQ(delta.added[2].kind, custom_msgs::msg::InventoryItem::TRAY);
+    EXPECT_EQ(tracker.size(), 3u);
+}
+
+//=============================================//
+TEST(InventoryTracker, DropsTheSameFrame)
+{
+    std::atomic<uint32_t> next_id{0};
+    InventoryTracker tracker(next_id, 0.1, 0.005);
+
+    auto image = make_image();
+    add_part(image, BATTERY, RED, 0.0, 0.0);
+
+    custom_msgs::msg::InventoryDelta delta;
+    ASSERT_TRUE(tracker.update(image, delta));
+
+    // below the move tolerance
+    image.part_poses[0].pose.position.x = 0.001;
+    EXPECT_FALSE(tracker.update(image, delta));
+}
+
+//=============================================//
+TEST(InventoryTracker, KeepsTheIdOfAMovedObject)
+{
+    std::atomic<uint32_t> next_id{0};
+    InventoryTracker tracker(next_id, 0.1, 0.005);
+
+    auto image = make_image();
+    add_part(image, BATTERY, RED, 0.0, 0.0);
+    add_part(image, BATTERY, RED, 0.5, 0.0);
+
+    custom_msgs::msg::InventoryDelta delta;
+    ASSERT_TRUE(tracker.update(image, delta));
+    auto first_id = delta.added[0].id;
+    auto second_id = delta.added[1].id;
+
+    // the frame lists the parts in the other order, the first one moved by 5 cm
+    auto moved = make_image();
+    add_part(moved, BATTERY, RED, 0.5, 0.0);
+    add_part(moved, BATTERY, RED, 0.05, 0.0);
+
+    ASSERT_TRUE(tracker.update(moved, delta));
+    EXPECT_TRUE(delta.added.empty());
+    EXPECT_TRUE(delta.removed.empty());
+    ASSERT_EQ(delta.moved.size(), 1u);
+    EXPECT_EQ(delta.moved[0].id, first_id);
+    EXPECT_NE(delta.moved[0].id, second_id);
+}
+
+//=============================================//
+TEST(InventoryTracker, RemovesObjectsNoLongerSeen)
+{
+    std::atomic<uint32_t> next_id{0};
+    InventoryTracker tracker(next_id, 0.1, 0.005);
+
+    auto image = make_image();
+    add_part(image, BATTERY, RED, 0.0, 0.0);
+    add_tray(image, 3, 1.0, 0.0);
+
+    custom_msgs::msg::InventoryDelta delta;
+    ASSERT_TRUE(tracker.update(image, delta));
+    auto tray_id = delta.added[1].id;
+
+    // the tray was picked up, a part far from the old one is a new part
+    auto next = make_image();
+    add_part(next, BATTERY, RED, 0.0, 0.5);
+
+    ASSERT_TRUE(tracker.update(next, delta));
+    ASSERT_EQ(delta.removed.size(), 2u);
+    EXPECT_EQ(delta.removed[1].id, tray_id);
+    ASSERT_EQ(delta.added.size(), 1u);
+    EXPECT_EQ(tracker.size(), 1u);
+}
+
+//=============================================//
+TEST(InventoryTracker, SharesTheIdsAcrossCameras)
+{
+    std::atomic<uint32_t> next_id{0};
+    InventoryTracker left(next_id, 0.1, 0.005);
+    InventoryTracker right(next_id, 0.1, 0.005);
+
+    auto image = make_image();
+    add_part(image, BATTERY, RED, 0.0, 0.0);
+
+    custom_msgs::msg::InventoryDelta left_delta, right_delta;
+    ASSERT_TRUE(left.update(image, left_delta));
+    ASSERT_TRUE(right.update(image, right_delta));
+    EXPECT_NE(left_delta.added[0].id, right_delta.added[0].id);
+}
@@ -0,0 +1,181 @@
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <thread>
+
+#include "order_queue.hpp"
+
+namespace
+{
+    ariac_msgs::msg::Order make_order(const std::string &id, int agv_number)
+    {
+        ariac_msgs::msg::Order order;
+        order.id = id;
+        order.type = ariac_msgs::msg::Order::KITTING;
+        order.kitting_task.agv_number = agv_number;
+        return order;
+    }
+} // namespace
+
+//=============================================//
+TEST(OrderQueue, PopsInArrivalOrder)
+{
+    OrderQueue queue;
+    queue.push(make_order("a", 1));
+    queue.push(make_order("b", 2));
+    queue.push(make_order("c", 3));
+    EXPECT_EQ(queue.size(), 3u);
+
+    OrderProgress progress;
+    for (auto const &id : {"a", "b", "c"})
+    {
+        ASSERT_EQ(queue.pop(progress, 0.0), WaitResult::READY);
+        EXPECT_EQ(progress.order.id, id);
+    }
+    EXPECT_EQ(queue.size(), 0u);
+}
+
+//=============================================//
+TEST(OrderQueue, PopTimesOutWhenEmpty)
+{
+    OrderQueue queue;
+    OrderProgress progress;
+    EXPECT_EQ(queue.pop(progress, 0.01), WaitResult::TIMEOUT);
+}
+
+//=============================================//
+TEST(OrderQueue, PopWakesUpOnPush)
+{
+    OrderQueue queue;
+    std::thread producer([&queue]()
+                         {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        queue.push(make_order("a", 1)); });
+
+    OrderProgress progress;
+    EXPECT_EQ(queue.pop(progress, 5.0), WaitResult::READY);
+    EXPECT_EQ(progress.order.id, "a");
+    producer.join();
+}
+
+//=============================================//
+TEST(OrderQueue, DrainedQueueReturnsLeftOrdersFirst)
+{
+    OrderQueue queue;
+    queue.push(make_order("a", 1));
+    queue.drain();
+
+    OrderProgress progress;
+    EXPECT_EQ(queue.pop(progress, 5.0), WaitResult::READY);
+    EXPECT_EQ(queue.pop(progress, 5.0), WaitResult::DRAINED);
+}
+
+//=============================================//
+TEST(OrderQueue, CancelWakesUpAndFailsEveryPop)
+{
+    OrderQueue queue;
+    std::thread canceller([&queue]()
+                          {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        queue.cancel(); });
+
+    OrderProgress progress;
+    EXPECT_EQ(queue.pop(progress, 5.0), WaitResult::CANCELLED);
+    canceller.join();
+
+    queue.push(make_order("a", 1));
+    EXPECT_EQ(queue.pop(progress, 0.0), WaitResult::CANCELLED);
+}
+
+//=============================================//
+TEST(OrderQueue, PriorityOrdersComeFirstInArrivalOrder)
+{
+    OrderQueue queue;
+    queue.push(make_order("a", 1));
+    auto p1 = make_order("p1", 2);
+    p1.priority = true;
+    queue.push(p1);
+    queue.push(make_order("b", 3));
+    auto p2 = make_order("p2", 4);
+    p2.priority = true;
+    queue.push(p2);
+
+    OrderProgress progress;
+    for (auto const &id : {"p1", "p2", "a", "b"})
+    {
+        ASSERT_EQ(queue.pop(progress, 0.0), WaitResult::READY);
+        EXPECT_EQ(progress.order.id, id);
+    }
+}
+
+//=============================================//
+TEST(OrderQueue, RequeuedOrderKeepsItsRank)
+{
+    OrderQueue queue;
+    queue.push(make_order("a", 1));
+    queue.push(make_order("b", 2));
+
+    OrderProgress current;
+    ASSERT_EQ(queue.pop(current, 0.0), WaitResult::READY);
+    current.parts_placed = 2;
+    current.preemptions++;
+    queue.requeue(current);
+
+    OrderProgress progress;
+    ASSERT_EQ(queue.pop(progress, 0.0), WaitResult::READY);
+    EXPECT_EQ(progress.order.id, "a");
+    EXPECT_EQ(progress.parts_placed, 2u);
+    EXPECT_EQ(progress.preemptions, 1u);
+}
+
+//=============================================//
+TEST(OrderQueue, PreemptsForPriorityOrdersOfOtherAgvs)
+{
+    OrderQueue queue;
+    queue.push(make_order("a", 1));
+
+    OrderProgress current;
+    ASSERT_EQ(queue.pop(current, 0.0), WaitResult::READY);
+    EXPECT_FALSE(queue.preempts(current));
+
+    queue.push(make_order("b", 2));
+    EXPECT_FALSE(queue.preempts(current));
+
+    // a priority kit for the same AGV cannot start on its tray
+    auto same_agv = make_order("p1", 1);
+    same_agv.priority = true;
+    queue.push(same_agv);
+    EXPECT_FALSE(queue.preempts(current));
+
+    auto other_agv = make_order("p2", 3);
+    other_agv.priority = true;
+    queue.push(other_agv);
+    EXPECT_TRUE(queue.preempts(current));
+
+    // a priority order is never preempted
+    current.order.priority = true;
+    EXPECT_FALSE(queue.preempts(current));
+}
+
+//=============================================//
+TEST(OrderQueue, NewKitWaitsForThePreemptedKitOfItsAgv)
+{
+    OrderQueue queue;
+    queue.push(make_order("a", 1));
+
+    OrderProgress current;
+    ASSERT_EQ(queue.pop(current, 0.0), WaitResult::READY);
+
+    auto priority = make_order("p", 1);
+    priority.priority = true;
+    queue.push(priority);
+    current.parts_placed = 1;
+    queue.requeue(current);
+
+    // the priority kit for AGV 1 would reuse the tray holding the preempted kit
+    OrderProgress progress;
+    ASSERT_EQ(queue.pop(progress, 0.0), WaitResult::READY);
+    EXPECT_EQ(progress.order.id, "a");
+    ASSERT_EQ(queue.pop(progress, 0.0), WaitResult::READY);
+    EXPECT_EQ(progress.order.id, "p");
+}
@@ -0,0 +1,90 @@
+#include <gtest/gtest.h>
+
+#include "scene_object_manager.hpp"
+
+class SceneObjectManagerTest : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        ASSERT_GT(meshes_.load_directory(RWA67_MESH_DIRECTORY), 0u);
+        pose_.orientation.w = 1.0;
+    }
+
+    MeshRegistry meshes_;
+    SceneObjectManager manager_{meshes_};
+    PlanningSceneBuilder builder_;
+    geometry_msgs::msg::Pose pose_;
+};
+
+//=============================================//
+TEST_F(SceneObjectManagerTest, GivesEachObjectItsOwnId)
+{
+    auto first = manager_.add(builder_, "kit_tray_3", "kit_tray.stl", pose_);
+    auto second = manager_.add(builder_, "kit_tray_3", "kit_tray.stl", pose_);
+    EXPECT_FALSE(first.empty());
+    EXPECT_NE(first, second);
+    EXPECT_EQ(first.rfind("kit_tray_3#", 0), 0u);
+    EXPECT_EQ(builder_.size(), 2u);
+    EXPECT_EQ(manager_.live_count(), 2u);
+}
+
+//=============================================//
+TEST_F(SceneObjectManagerTest, UnknownMeshIsNotAdded)
+{
+    EXPECT_TRUE(manager_.add(builder_, "part", "missing.stl", pose_).empty());
+    EXPECT_TRUE(builder_.empty());
+    EXPECT_EQ(manager_.live_count(), 0u);
+}
+
+//=============================================//
+TEST_F(SceneObjectManagerTest, GoesThroughTheLifecycle)
+{
+    auto id = manager_.add(builder_, "red_battery", "battery.stl", pose_);
+    EXPECT_EQ(manager_.state(id), SceneObjectState::ADDED);
+
+    // only an attached object can be released
+    EXPECT_FALSE(manager_.detach(id, "agv1/1"));
+
+    ASSERT_TRUE(manager_.attach(id));
+    EXPECT_EQ(manager_.state(id), SceneObjectState::ATTACHED);
+
+    // an attached object stays in the scene
+    builder_.clear();
+    EXPECT_FALSE(manager_.remove(builder_, id));
+    EXPECT_TRUE(builder_.empty());
+
+    ASSERT_TRUE(manager_.detach(id, "agv1/1"));
+    EXPECT_EQ(manager_.state(id), SceneObjectState::DETACHED);
+    EXPECT_EQ(manager_.find("red_battery", "agv1/1"), id);
+
+    ASSERT_TRUE(manager_.remove(builder_, id));
+    EXPECT_EQ(manager_.state(id), SceneObjectState::REMOVED);
+    ASSERT_EQ(builder_.size(), 1u);
+    EXPECT_EQ(builder_.collision_objects().front().operation, moveit_msgs::msg::CollisionObject::REMOVE);
+    EXPECT_FALSE(manager_.attach(id));
+}
+
+//=============================================//
+TEST_F(SceneObjectManagerTest, CollectsTheObjectsOfAnArea)
+{
+    auto tray = manager_.add(builder_, "kit_tray_1", "kit_tray.stl", pose_);
+    auto part = manager_.add(builder_, "red_battery", "battery.stl", pose_);
+    auto other = manager_.add(builder_, "blue_pump", "pump.stl", pose_);
+    auto held = manager_.add(builder_, "green_sensor", "sensor.stl", pose_);
+    for (auto const &id : {tray, part, other, held})
+        manager_.attach(id);
+    manager_.detach(tray, "agv1");
+    manager_.detach(part, "agv1/2");
+    // "agv10" is not part of the area "agv1"
+    manager_.detach(other, "agv10/1");
+
+    builder_.clear();
+    EXPECT_EQ(manager_.collect(builder_, "agv1"), 2u);
+    EXPECT_EQ(builder_.size(), 2u);
+    EXPECT_EQ(manager_.state(tray), SceneObjectState::REMOVED);
+    EXPECT_EQ(manager_.state(part), SceneObjectState::REMOVED);
+    EXPECT_EQ(manager_.state(other), SceneObjectState::DETACHED);
+    EXPECT_EQ(manager_.state(held), SceneObjectState::ATTACHED);
+    EXPECT_EQ(manager_.live_count(), 2u);
+}
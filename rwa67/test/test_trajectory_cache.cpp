@@ -0,0 +1,151 @@
+#include <gtest/gtest.h>
+
+#include "trajectory_cache.hpp"
+
+namespace
+{
+    geometry_msgs::msg::Pose make_pose(double x, double y, double z)
+    {
+        geometry_msgs::msg::Pose pose;
+        pose.position.x = x;
+        pose.position.y = y;
+        pose.position.z = z;
+        pose.orientation.w = 1.0;
+        return pose;
+    }
+
+    //! Trajectory told apart by its single joint name
+    moveit_msgs::msg::RobotTrajectory make_trajectory(const std::string &name)
+    {
+        moveit_msgs::msg::RobotTrajectory trajectory;
+        trajectory.joint_trajectory.joint_names.push_back(name);
+        return trajectory;
+    }
+
+    std::string make_key(const TrajectoryCache &cache, double joint, double z, double vsf = 0.3)
+    {
+        std::string key;
+        cache.make_key({joint, 0.0}, {make_pose(0.1, 0.2, z)}, vsf, vsf, key);
+        return key;
+    }
+} // namespace
+
+//=============================================//
+TEST(TrajectoryCache, KeyQuantizesTheRequest)
+{
+    TrajectoryCache cache;
+
+    // below the resolutions (1e-3 for joints and positions)
+    EXPECT_EQ(make_key(cache, 0.5, 0.3), make_key(cache, 0.5002, 0.3002));
+    EXPECT_NE(make_key(cache, 0.5, 0.3), make_key(cache, 0.502, 0.3));
+    EXPECT_NE(make_key(cache, 0.5, 0.3), make_key(cache, 0.5, 0.302));
+    EXPECT_NE(make_key(cache, 0.5, 0.3, 0.3), make_key(cache, 0.5, 0.3, 0.2));
+}
+
+//=============================================//
+TEST(TrajectoryCache, StartWithinTheToleranceHits)
+{
+    // joint resolution set to the start tolerance of the floor robot
+    TrajectoryCache cache(8, 0.01);
+    auto key = make_key(cache, 0.5, 0.3);
+    cache.insert(key, make_trajectory("a"), 0.2);
+
+    moveit_msgs::msg::RobotTrajectory trajectory;
+    EXPECT_TRUE(cache.lookup(make_key(cache, 0.504, 0.3), trajectory));
+    EXPECT_TRUE(cache.lookup(make_key(cache, 0.496, 0.3), trajectory));
+    EXPECT_FALSE(cache.lookup(make_key(cache, 0.52, 0.3), trajectory));
+}
+
+//=============================================//
+TEST(TrajectoryCache, KeyIgnoresTheQuaternionSign)
+{
+    TrajectoryCache cache;
+
+    auto pose = make_pose(0.1, 0.2, 0.3);
+    pose.orientation.x = 0.5;
+    pose.orientation.w = 0.5;
+    auto flipped = pose;
+    flipped.orientation.x = -0.5;
+    flipped.orientation.w = -0.5;
+
+    std::string key, flipped_key;
+    cache.make_key({0.0}, {pose}, 1.0, 1.0, key);
+    cache.make_key({0.0}, {flipped}, 1.0, 1.0, flipped_key);
+    EXPECT_EQ(key, flipped_key);
+}
+
+//=============================================//
+TEST(TrajectoryCache, LookupCountsHitsAndMisses)
+{
+    TrajectoryCache cache;
+    auto key = make_key(cache, 0.5, 0.3);
+
+    moveit_msgs::msg::RobotTrajectory trajectory;
+    EXPECT_FALSE(cache.lookup(key, trajectory));
+
+    cache.insert(key, make_trajectory("a"), 0.25);
+    ASSERT_TRUE(cache.lookup(key, trajectory));
+    EXPECT_EQ(trajectory.joint_trajectory.joint_names.front(), "a");
+
+    auto stats = cache.stats();
+    EXPECT_EQ(stats.hits, 1u);
+    EXPECT_EQ(stats.misses, 1u);
+    EXPECT_DOUBLE_EQ(stats.saved_planning_time, 0.25);
+}
+
+//=============================================//
+TEST(TrajectoryCache, EvictsTheLeastRecentlyUsedEntry)
+{
+    TrajectoryCache cache(2);
+    auto key_a = make_key(cache, 0.1, 0.3);
+    auto key_b = make_key(cache, 0.2, 0.3);
+    auto key_c = make_key(cache, 0.3, 0.3);
+
+    cache.insert(key_a, make_trajectory("a"), 0.1);
+    cache.insert(key_b, make_trajectory("b"), 0.1);
+
+    // a becomes the most recently used, b is evicted
+    moveit_msgs::msg::RobotTrajectory trajectory;
+    ASSERT_TRUE(cache.lookup(key_a, trajectory));
+    cache.insert(key_c, make_trajectory("c"), 0.1);
+
+    EXPECT_EQ(cache.size(), 2u);
+    EXPECT_TRUE(cache.lookup(key_a, trajectory));
+    EXPECT_FALSE(cache.lookup(key_b, trajectory));
+    EXPECT_TRUE(cache.lookup(key_c, trajectory));
+}
+
+//=============================================//
+TEST(TrajectoryCache, RejectTurnsTheHitIntoAMiss)
+{
+    TrajectoryCache cache;
+    auto key = make_key(cache, 0.5, 0.3);
+    cache.insert(key, make_trajectory("a"), 0.25);
+
+    moveit_msgs::msg::RobotTrajectory trajectory;
+    ASSERT_TRUE(cache.lookup(key, trajectory));
+    cache.reject(key);
+
+    auto stats = cache.stats();
+    EXPECT_EQ(stats.hits, 0u);
+    EXPECT_EQ(stats.misses, 1u);
+    EXPECT_EQ(stats.rejected, 1u);
+    EXPECT_DOUBLE_EQ(stats.saved_planning_time, 0.0);
+    EXPECT_FALSE(cache.lookup(key, trajectory));
+}
+
+//=============================================//
+TEST(TrajectoryCache, ClearKeepsTheCounters)
+{
+    TrajectoryCache cache;
+    auto key = make_key(cache, 0.5, 0.3);
+    cache.insert(key, make_trajectory("a"), 0.25);
+
+    moveit_msgs::msg::RobotTrajectory trajectory;
+    ASSERT_TRUE(cache.lookup(key, trajectory));
+    cache.clear();
+
+    EXPECT_EQ(cache.size(), 0u);
+    EXPECT_EQ(cache.stats().hits, 1u);
+    EXPECT_FALSE(cache.lookup(key, trajectory));
+}